@@ -0,0 +1,114 @@
+#include "storage_mgr.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// Throughput of concurrent pinPage/unpinPage on one pool, for 1, 2, 4, ...
+// threads up to the number of cores. Two workloads: every page fits in the
+// pool (hits only), and a page set twenty times the pool (mostly misses,
+// served from the OS page cache). Each runs on one pool and on a pool split
+// into one shard per core.
+
+#define BENCH_FILE "benchbuffer.bin"
+#define BENCH_FRAMES 1000
+#define BENCH_OPS 200000
+
+typedef struct BenchArgs {
+  BM_BufferPool *bm;
+  int numPages;
+  unsigned int seed;
+} BenchArgs;
+
+static void *
+benchWorker (void *arg)
+{
+  BenchArgs *args = (BenchArgs *) arg;
+  BM_PageHandle h;
+  int i;
+
+  for (i = 0; i < BENCH_OPS; i++)
+    {
+      if (pinPage(args->bm, &h, rand_r(&args->seed) % args->numPages) != RC_OK)
+        {
+          printf("pinPage failed\n");
+          exit(1);
+        }
+      unpinPage(args->bm, &h);
+    }
+  return NULL;
+}
+
+static double
+now (void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+benchWorkload (const char *name, ReplacementStrategy strategy, int numPages, int maxThreads, int numShards)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * maxThreads);
+  BenchArgs *args = (BenchArgs *) malloc(sizeof(BenchArgs) * maxThreads);
+  double start, elapsed;
+  int numThreads, i;
+
+  setPoolShards(numShards);
+  CHECK(initBufferPool(bm, BENCH_FILE, BENCH_FRAMES, strategy, NULL));
+  setPoolShards(1);
+
+  for (numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+    {
+      start = now();
+      for (i = 0; i < numThreads; i++)
+        {
+          args[i].bm = bm;
+          args[i].numPages = numPages;
+          args[i].seed = i + 1;
+          pthread_create(&threads[i], NULL, benchWorker, &args[i]);
+        }
+      for (i = 0; i < numThreads; i++)
+        pthread_join(threads[i], NULL);
+      elapsed = now() - start;
+
+      printf("%-8s %-6s %3d shards %3d threads: %10.0f pins/s\n", name,
+             strategy == RS_LRU ? "LRU" : strategy == RS_CLOCK ? "CLOCK" : "other",
+             numShards, numThreads, (double) numThreads * BENCH_OPS / elapsed);
+    }
+
+  CHECK(shutdownBufferPool(bm));
+  free(bm);
+  free(threads);
+  free(args);
+}
+
+int
+main (void)
+{
+  int cores = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  SM_FileHandle fh;
+
+  initStorageManager();
+  CHECK(createPageFile(BENCH_FILE));
+  CHECK(openPageFile(BENCH_FILE, &fh));
+  CHECK(ensureCapacity(20 * BENCH_FRAMES, &fh));
+  CHECK(closePageFile(&fh));
+
+  if (cores < 1) cores = 1;
+  benchWorkload("hits", RS_LRU, BENCH_FRAMES / 2, cores, 1);
+  benchWorkload("hits", RS_CLOCK, BENCH_FRAMES / 2, cores, 1);
+  benchWorkload("hits", RS_LRU, BENCH_FRAMES / 2, cores, cores);
+  benchWorkload("misses", RS_LRU, 20 * BENCH_FRAMES, cores, 1);
+  benchWorkload("misses", RS_CLOCK, 20 * BENCH_FRAMES, cores, 1);
+  benchWorkload("misses", RS_LRU, 20 * BENCH_FRAMES, cores, cores);
+
+  CHECK(destroyPageFile(BENCH_FILE));
+  return 0;
+}
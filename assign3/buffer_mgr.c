@@ -1,26 +1,183 @@
 #include "buffer_mgr.h"
 #include "storage_mgr.h"
+#include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-
-#include <signal.h>
-
-static int NumReadIO = 0;
-static int NumWriteIO = 0;
+#include <sys/mman.h>
+#include <time.h>
+
+static BM_HugePages hugePages = BM_HUGE_PAGES_OFF;
+static int poolShards = 1;
+static int cleanerInterval = 0;  // page cleaner settings, see setPageCleaner
+static int cleanerMaxPages = 0;
+static int cleanerPercent = 0;
+
+#define BM_CACHE_LINE 64                 // frame metadata arrays start on a cache line
+#define BM_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define BM_PREFETCH_DEPTH 16             // prefetch reads in flight at most
+#define BM_PREFETCH_QUEUE 256            // prefetch requests waiting at most
+#define BM_MAX_FILES 256                 // page files registered with a pool at most
+#define BM_FLUSH_RUN 32                  // adjacent pages a flush writes with one call at most
+
+#define LFU_MAX_COUNT 64     // LFU: use counts saturate here, one bucket per count
+#define LFU_AGING_PERIOD 16  // LFU: counts are halved every numPages * this many accesses
+#define LRUK_DEFAULT_K 2     // LRU-K: K when stratData is NULL
+#define ARC_T1 0             // ARC: list of pages seen once recently (and its ghosts B1)
+#define ARC_T2 1             // ARC: list of pages seen at least twice (and its ghosts B2)
+#define ARC_NONE -1          // ARC: frame not loaded yet
+
+/* Page table: maps the page number of every loaded page to its frame.
+ * Open addressing with linear probing over a power of two number of slots,
+ * more than twice the number of frames so probe sequences stay short and,
+ * with a frame mapping its old and new page while it loads, a slot is
+ * always empty to end them.
+ */
+typedef struct BM_PageTable {
+  PageNumber *keys; // page number in each slot, NO_PAGE if the slot is empty
+  int *frames;      // frame holding the page of the slot
+  int bits;         // log2 of the number of slots
+  int mask;         // number of slots - 1
+} BM_PageTable;
+
+/* Memory of some frames of a shard, allocated at once: the arena of
+ * initBufferPool, and one more for the frames each growth adds. A frame
+ * stays at the same address, with the same latch, while it is in use.
+ */
+typedef struct BM_Chunk {
+  char *mem;         // the frames, one after the other
+  void *map;         // mapping holding mem, NULL if it is on the heap
+  size_t mapSize;
+  pthread_rwlock_t *latches; // latch of each frame
+  int *frameOf;      // shard frame using each frame of the chunk, -1 if none
+  int numFrames;
+  int numUsed;       // frames of the chunk in use, the chunk is freed at 0
+} BM_Chunk;
 
 /* A structure that stores bookkeeping data of buffer manager pool. 
  */
 typedef struct BM_PoolInfo {
+  BM_PageTable table; // page number -> frame index
   int numPages;
   SM_FileHandle *fh;// file handler of page file associated with buffer pool
+  SM_FileHandle **files;        // registered page files by id, those of the pool; read with fileLatch held
+  pthread_mutex_t latch;        // protects the page table and the replacement state
+  pthread_cond_t ioDone;        // broadcast when a frame finishes loading
+  pthread_rwlock_t *fileLatch;  // shared by page I/O, exclusive to grow the file; one per pool
+  pthread_rwlock_t resizeLatch; // shared by every access to the frame arrays, exclusive to resize
+  pthread_rwlock_t **frameLatches; // read/write latch of each frame, see pinPageLatched
+  bool *loading;    // frame is being written back and read, its pages are not usable yet
+  bool *prefetched; // frame was loaded by the prefetcher and not pinned since
   bool *dirtys;     // dirty flags array
-  int *fixCounter;  // fix counter array
+  int *fixCounter;  // fix counter array, changed with atomic operations
   PageNumber *map;  // mapping between page frames and page numbers
   int fifo_old;     // circular FIFO, index of the oldest added item
-  int *lru_stamp;   // used stamp, begins at 0
+  int numPinned;    // frames with a fix count above 0, changed with atomic operations
+  int lru_head;     // LRU list: most recently used frame
+  int lru_tail;     // LRU list: least recently used frame
+  int *lru_prev;    // LRU list: next more recently used frame, -1 at the head
+  int *lru_next;    // LRU list: next less recently used frame, -1 at the tail
+  int clock_hand;   // CLOCK: next frame the hand looks at
+  bool *clock_ref;  // CLOCK: reference bits, set on every access
+  int *lfu_count;   // LFU: use count of each frame, the bucket it is in
+  int *lfu_prev;    // LFU: bucket list, next more recently used frame, -1 at the head
+  int *lfu_next;    // LFU: bucket list, next less recently used frame, -1 at the tail
+  int lfu_head[LFU_MAX_COUNT + 1]; // LFU: most recently used frame of each bucket
+  int lfu_tail[LFU_MAX_COUNT + 1]; // LFU: least recently used frame of each bucket
+  long lfu_accesses;             // LFU: accesses since counts were last halved
+  int lruk_k;                    // LRU-K: number of references kept per page
+  long long lruk_clock;          // LRU-K: logical time, one tick per access
+  long long *lruk_times;         // LRU-K: last K access times of each frame, most recent first, 0 if none
+  BM_PageTable lruk_table;       // LRU-K: evicted page -> slot of its retained history
+  PageNumber *lruk_pages;        // LRU-K: page owning each history slot, NO_PAGE if free
+  long long *lruk_history;       // LRU-K: access times retained per slot
+  int lruk_next;                 // LRU-K: history slot reused next, circular
+  int arc_p;                     // ARC: target size of T1, adapted on ghost hits
+  int *arc_list;                 // ARC: ARC_T1 or ARC_T2 for each frame
+  int *arc_prev;                 // ARC: resident lists, next more recently used frame
+  int *arc_next;                 // ARC: resident lists, next less recently used frame
+  int arc_head[2], arc_tail[2], arc_size[2]; // ARC: T1 and T2
+  BM_PageTable arc_ghosts;       // ARC: evicted page -> ghost slot
+  PageNumber *arc_ghost_page;    // ARC: page of each ghost slot
+  int *arc_ghost_list;           // ARC: ARC_T1 (B1) or ARC_T2 (B2) for each ghost slot
+  int *arc_gprev;                // ARC: ghost lists, next more recently evicted slot
+  int *arc_gnext;                // ARC: ghost lists, next less recently evicted slot, free slots chain
+  int arc_ghead[2], arc_gtail[2], arc_gsize[2]; // ARC: B1 and B2
+  int arc_gfree;                 // ARC: first free ghost slot, -1 if none
   char **frames;    // frames pointer array
+  BM_Chunk *chunks; // memory of the frames
+  int numChunks;
+  void *meta;       // block holding the per-frame arrays above
+  int numPrefetching;   // frames pinned by the prefetcher while it reads them
+  PageNumber claimedOld; // set by loadFrame when it claims a frame for the prefetcher:
+  bool claimedDirty;     // the page the frame held and whether it needs writing back
+  int numReadIO;    // pages read into this shard, atomic
+  int numWriteIO;   // pages written from this shard (failed writes not counted), atomic
+  int numEvictionWrites; // dirty victims written back on a miss, atomic
+  int numCleanerWrites;  // pages written by the page cleaner, atomic
+  int numPrefetchReads;  // pages read by the prefetcher, atomic
+  long long numPins;     // pins that succeeded, atomic like the counters below
+  long long numUnpins;
+  long long numHits;     // pins finding their page resident
+  long long numMisses;   // pins loading their page
+  long long numEvictions; // resident pages replaced by another page
+  long long missLatency[BM_LATENCY_BUCKETS]; // misses by time taken, see BM_PoolStats
 } BM_PoolInfo;
 
+/* A prefetch read in flight: the frame it claimed and how to undo it.
+ */
+typedef struct BM_Prefetch {
+  BM_PoolInfo *pi;
+  int index;
+  PageNumber pageNum;
+  PageNumber old;   // page the frame held before
+  bool written;     // old is on disk (or NO_PAGE), it needs no restoring on a failed read
+} BM_Prefetch;
+
+/* A dirty page collected by forceFlushPool, pinned until it is written.
+ */
+typedef struct BM_FlushPage {
+  PageNumber key;
+  char *data;
+  pthread_rwlock_t *latch; // its frame latch
+  BM_PoolInfo *pi;
+} BM_FlushPage;
+
+/* A buffer pool: numShards independent shards, each with its own frames,
+ * page table, replacement state, latch and counters. A page always lives
+ * in the shard chosen by a hash of its number; the shards share the page
+ * file. bm->mgmtData points to this.
+ */
+typedef struct BM_Pool {
+  int numShards;
+  BM_PoolInfo *shards;
+  SM_FileHandle *fh;
+  SM_FileHandle *files[BM_MAX_FILES]; // page files by id, NULL if free; files[0] is fh
+  pthread_rwlock_t fileLatch;         // shared by page I/O, exclusive to grow a file or change files
+  // statistics across shards, frames of shard 0 first; unused with one shard
+  PageNumber *map;
+  bool *dirtys;
+  int *fixCounts;
+  // background page cleaner, running if cleanInterval > 0
+  ReplacementStrategy strategy;
+  int cleanInterval;          // milliseconds between two rounds
+  int cleanMaxPages;          // pages written per shard and round at most
+  int cleanPercent;           // target share of clean frames among the unpinned ones
+  pthread_t cleaner;
+  pthread_mutex_t cleanerLock;
+  pthread_cond_t cleanerWake; // signalled to stop the cleaner
+  bool cleanerStop;
+  // prefetcher, started by the first prefetchPages
+  pthread_t prefetcher;
+  pthread_mutex_t prefetchLock;
+  pthread_cond_t prefetchWake; // signalled when pages are queued or to stop
+  bool prefetcherRunning;
+  bool prefetchStop;
+  PageNumber prefetchQueue[BM_PREFETCH_QUEUE]; // ring of requested pages
+  int prefetchHead;
+  int prefetchCount;
+} BM_Pool;
+
 /************************************************************
  *                    Functions definitions                 *
  ************************************************************/
@@ -37,6 +194,18 @@ void printIntArray(const char* objectName, int *i_a, int length) {
   printf("%d]\n", i_a[length - 1]);
 }
 
+/* A function to print elements in a page number array.
+ * The elements start at index 0 and ends at index length-1.
+ */
+void printPageArray(const char* objectName, PageNumber *p_a, int length) {
+  printf("%s:\t\t [", objectName);
+  int i;
+  for (i = 0; i < (length - 1); i++) {
+    printf("%lld, ", p_a[i]);
+  }
+  printf("%lld]\n", p_a[length - 1]);
+}
+
 /* A function to print elements in a boolean array.
  * The elements start at index 0 and ends at index length-1.
  */
@@ -68,12 +237,16 @@ void printPoolInfo(BM_PoolInfo *pi) {
   SM_FileHandle *fh = pi->fh;
   printf("numPages:\t\t %d\n", pi->numPages);
   printf("fh->fileName:\t\t %s\n", fh->fileName);
-  printf("fh->totalNumPages:\t\t %d\n", fh->totalNumPages);
+  printf("fh->totalNumPages:\t\t %lld\n", fh->totalNumPages);
   printBoolArray("dirtys", pi->dirtys, pi->numPages);
   printIntArray("fixCounter", pi->fixCounter, pi->numPages);
-  printIntArray("map", pi->map, pi->numPages);
+  printPageArray("map", pi->map, pi->numPages);
   printf("fifo_old:\t\t %d\n", pi->fifo_old);
-  printIntArray("lru_stamp", pi->lru_stamp, pi->numPages);
+  printIntArray("lru_prev", pi->lru_prev, pi->numPages);
+  printIntArray("lru_next", pi->lru_next, pi->numPages);
+  printf("clock_hand:\t\t %d\n", pi->clock_hand);
+  printBoolArray("clock_ref", pi->clock_ref, pi->numPages);
+  printIntArray("lfu_count", pi->lfu_count, pi->numPages);
   printStrArray("frames", pi->frames, pi->numPages);
 
 }
@@ -90,54 +263,736 @@ int searchArray(int x, int *a, int length) {
   return -1;
 }
 
-/* A function to linearly search the lowest value in an integer array.
- * The search start at index 0 and ends at index length-1.
+/* A function to size an empty page table for numFrames frames.
+ */
+void initPageTable(BM_PageTable *pt, int numFrames) {
+  int i, slots;
+
+  pt->bits = 1;
+  while ((1 << pt->bits) <= 2 * numFrames) pt->bits++;
+  slots = 1 << pt->bits;
+  pt->mask = slots - 1;
+  pt->keys = (PageNumber *)malloc(sizeof(PageNumber) * slots);
+  pt->frames = (int *)malloc(sizeof(int) * slots);
+  for (i = 0; i < slots; i++) {
+    pt->keys[i] = NO_PAGE;
+  }
+}
+
+void freePageTable(BM_PageTable *pt) {
+  free(pt->keys);
+  free(pt->frames);
+}
+
+/* Home slot of a page number: Fibonacci hashing, so consecutive page numbers
+ * spread over the table.
+ */
+static int pageTableSlot(BM_PageTable *pt, PageNumber pageNum) {
+  return (int)(((uint64_t)pageNum * 0x9E3779B97F4A7C15ULL) >> (64 - pt->bits));
+}
+
+/* A function to find the frame holding pageNum.
+ * The frame index is returned if the page is loaded, -1 if not.
+ */
+int lookupPage(BM_PageTable *pt, PageNumber pageNum) {
+  int slot = pageTableSlot(pt, pageNum);
+
+  while (pt->keys[slot] != NO_PAGE) {
+    if (pt->keys[slot] == pageNum) return pt->frames[slot];
+    slot = (slot + 1) & pt->mask;
+  }
+  return -1;
+}
+
+/* A function to record that pageNum was loaded into frame.
+ */
+void insertPage(BM_PageTable *pt, PageNumber pageNum, int frame) {
+  int slot = pageTableSlot(pt, pageNum);
+
+  while (pt->keys[slot] != NO_PAGE && pt->keys[slot] != pageNum) {
+    slot = (slot + 1) & pt->mask;
+  }
+  pt->keys[slot] = pageNum;
+  pt->frames[slot] = frame;
+}
+
+/* A function to forget pageNum once its frame is reused. The entries after
+ * it in the probe sequence are shifted back, so no tombstones are needed.
+ */
+void removePage(BM_PageTable *pt, PageNumber pageNum) {
+  int slot = pageTableSlot(pt, pageNum);
+  int next, home;
+
+  while (pt->keys[slot] != pageNum) {
+    if (pt->keys[slot] == NO_PAGE) return;
+    slot = (slot + 1) & pt->mask;
+  }
+
+  for (next = (slot + 1) & pt->mask; pt->keys[next] != NO_PAGE; next = (next + 1) & pt->mask) {
+    home = pageTableSlot(pt, pt->keys[next]);
+    // move the entry into the hole unless its home lies between hole and entry
+    if (((next - home) & pt->mask) >= ((next - slot) & pt->mask)) {
+      pt->keys[slot] = pt->keys[next];
+      pt->frames[slot] = pt->frames[next];
+      slot = next;
+    }
+  }
+  pt->keys[slot] = NO_PAGE;
+}
+
+/* A function to unlink frame index from the doubly linked frame list given
+ * by prev/next (prev points towards the head) and its head/tail.
+ */
+void unlinkFrame(int *prev, int *next, int *head, int *tail, int index) {
+  if (prev[index] >= 0) {
+    next[prev[index]] = next[index];
+  } else {
+    *head = next[index];
+  }
+  if (next[index] >= 0) {
+    prev[next[index]] = prev[index];
+  } else {
+    *tail = prev[index];
+  }
+}
+
+/* A function to push frame index at the head of a doubly linked frame list.
+ */
+void pushFrame(int *prev, int *next, int *head, int *tail, int index) {
+  prev[index] = -1;
+  next[index] = *head;
+  if (*head >= 0) {
+    prev[*head] = index;
+  } else {
+    *tail = index;
+  }
+  *head = index;
+}
+
+/* A function to read the fix count of frame index. Unpinning decrements
+ * it without the pool latch; the acquire pairs with that release, so the
+ * frame's dirty flag and data are seen as the unpinning thread left them.
+ */
+static int fixCount(BM_PoolInfo *pi, int index) {
+  return __atomic_load_n(&pi->fixCounter[index], __ATOMIC_ACQUIRE);
+}
+
+/* Choose how many shards buffer pools initialized from now on are split
+ * into (at most one per frame). Each shard replaces pages on its own, so
+ * pinners of different shards don't contend; a shard reports
+ * RC_PINNED_PAGES once all of its own frames are pinned.
+ */
+void setPoolShards(int numShards) {
+  poolShards = numShards < 1 ? 1 : numShards;
+}
+
+/* Set up the background page cleaner of pools initialized from now on.
+ * Every intervalMs milliseconds it looks at each shard and, while fewer
+ * than cleanPercent percent of the unpinned frames are clean, writes up to
+ * maxPages dirty unpinned pages, the likeliest victims first, so misses
+ * find clean victims and only pay for their read. intervalMs 0 turns the
+ * cleaner off, the default.
+ */
+void setPageCleaner(int intervalMs, int maxPages, int cleanPercent) {
+  cleanerInterval = intervalMs < 0 ? 0 : intervalMs;
+  cleanerMaxPages = maxPages < 1 ? 1 : maxPages;
+  cleanerPercent = cleanPercent < 0 ? 0 : (cleanPercent > 100 ? 100 : cleanPercent);
+}
+
+/* A function to find the shard holding pageNum: Fibonacci hashing, like the
+ * page table, so runs of consecutive pages spread over the shards.
+ */
+static BM_PoolInfo *shardOf(BM_Pool *pool, PageNumber pageNum) {
+  if (pool->numShards == 1) return pool->shards;
+  return pool->shards + (int)((((uint64_t)pageNum * 0x9E3779B97F4A7C15ULL) >> 32) % pool->numShards);
+}
+
+/* A function to find the registered page file of a page key, NULL if
+ * there is none. Called with the file latch held.
+ */
+static SM_FileHandle *fileOf(BM_PoolInfo *pi, PageNumber key) {
+  int fileId = BM_PAGE_FILE(key);
+  return (fileId >= 0 && fileId < BM_MAX_FILES) ? pi->files[fileId] : NULL;
+}
+
+/* A function to write the page of a page key from memPage to its file,
+ * with the file latch held.
+ */
+static RC writeFrame(BM_PoolInfo *pi, PageNumber key, char *memPage) {
+  SM_FileHandle *fh = fileOf(pi, key);
+
+  if (fh == NULL) return RC_FILE_HANDLE_NOT_INIT;
+  return writeBlock(BM_PAGE_NUMBER(key), fh, memPage);
+}
+
+/* Choose the memory of the frame arena of buffer pools initialized from now
+ * on. BM_HUGE_PAGES_EXPLICIT falls back to transparent huge pages when no
+ * huge pages are reserved, and those fall back to the heap.
+ */
+void setHugePages(BM_HugePages mode) {
+  hugePages = mode;
+}
+
+/* A function to hand out the next cache-line aligned piece of bytes from
+ * the metadata block at *cursor.
+ */
+static void *carve(char **cursor, size_t bytes) {
+  void *piece = *cursor;
+  *cursor += (bytes + BM_CACHE_LINE - 1) & ~(size_t)(BM_CACHE_LINE - 1);
+  return piece;
+}
+
+/* A function to allocate a chunk of numFrames frames for a shard, in
+ * one arena. The arena is aligned for SM_MODE_DIRECT files whichever
+ * memory backs it, and zeroed. Returns the index of the chunk.
+ */
+int allocChunk(BM_PoolInfo *pi, int numFrames) {
+  size_t size = (size_t)numFrames * pi->fh->pageSize;
+  size_t mapSize = (size + BM_HUGE_PAGE_SIZE - 1) & ~(size_t)(BM_HUGE_PAGE_SIZE - 1);
+  BM_Chunk *c;
+  void *m;
+  int i;
+
+  pi->chunks = (BM_Chunk *)realloc(pi->chunks, sizeof(BM_Chunk) * (pi->numChunks + 1));
+  c = &pi->chunks[pi->numChunks];
+  c->numFrames = numFrames;
+  c->numUsed = 0;
+  c->latches = (pthread_rwlock_t *)malloc(sizeof(pthread_rwlock_t) * numFrames);
+  c->frameOf = (int *)malloc(sizeof(int) * numFrames);
+  for (i = 0; i < numFrames; i++) {
+    pthread_rwlock_init(&c->latches[i], NULL);
+    c->frameOf[i] = -1;
+  }
+
+  c->map = NULL;
+  if (hugePages == BM_HUGE_PAGES_OFF) {
+    c->mem = allocFileBuffer(pi->fh, numFrames);
+    return pi->numChunks++;
+  }
+
+#ifdef MAP_HUGETLB
+  if (hugePages == BM_HUGE_PAGES_EXPLICIT) {
+    m = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, 
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (m != MAP_FAILED) {
+      c->map = m;
+      c->mapSize = mapSize;
+      c->mem = (char *)m;
+      return pi->numChunks++;
+    }
+  }
+#endif
+
+  // map one huge page more, so the arena can start on a huge page boundary
+  m = mmap(NULL, mapSize + BM_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, 
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (m == MAP_FAILED) {
+    c->mem = allocFileBuffer(pi->fh, numFrames);
+    return pi->numChunks++;
+  }
+  c->map = m;
+  c->mapSize = mapSize + BM_HUGE_PAGE_SIZE;
+  c->mem = (char *)(((uintptr_t)m + BM_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(BM_HUGE_PAGE_SIZE - 1));
+#ifdef MADV_HUGEPAGE
+  madvise(c->mem, mapSize, MADV_HUGEPAGE);
+#endif
+  return pi->numChunks++;
+}
+
+/* A function to free a chunk none of whose frames is in use.
  */
-int searchLowest(int *a, int length) {
+void freeChunk(BM_Chunk *c) {
   int i;
-  int x = a[0];
-  int j = 0;
-  for (i = 1; i < length; i++) {
-    if (a[i] < x) {
-      x = a[i];
-      j = i;
+
+  if (c->map != NULL) {
+    munmap(c->map, c->mapSize);
+  } else {
+    freePageBuffer(c->mem);
+  }
+  for (i = 0; i < c->numFrames; i++) {
+    pthread_rwlock_destroy(&c->latches[i]);
+  }
+  free(c->latches);
+  free(c->frameOf);
+}
+
+/* A function to make frame slot of chunk the memory of frame index.
+ */
+void useChunkFrame(BM_PoolInfo *pi, int index, int chunk, int slot) {
+  BM_Chunk *c = &pi->chunks[chunk];
+
+  pi->frames[index] = c->mem + (size_t)slot * pi->fh->pageSize;
+  pi->frameLatches[index] = &c->latches[slot];
+  c->frameOf[slot] = index;
+  c->numUsed++;
+}
+
+/* A function to find the chunk holding the memory of frame index, and
+ * the frame's slot in it.
+ */
+int chunkOf(BM_PoolInfo *pi, int index, int *slot) {
+  int c;
+
+  for (c = 0; c < pi->numChunks; c++) {
+    BM_Chunk *chunk = &pi->chunks[c];
+    if (pi->frames[index] >= chunk->mem && 
+        pi->frames[index] < chunk->mem + (size_t)chunk->numFrames * pi->fh->pageSize) {
+      *slot = (int)((pi->frames[index] - chunk->mem) / pi->fh->pageSize);
+      return c;
     }
   }
-  return j;
+  return -1;
+}
+
+/* A function to allocate the block holding the per-frame arrays of a
+ * shard of numPages frames. Returns NULL if out of memory.
+ */
+void *allocMeta(int numPages) {
+  size_t metaSize = numPages * (sizeof(PageNumber) + sizeof(char *) + sizeof(pthread_rwlock_t *)
+      + 6 * sizeof(int) + 4 * sizeof(bool)) + 13 * BM_CACHE_LINE;
+  void *meta = NULL;
+
+  if (posix_memalign(&meta, BM_CACHE_LINE, metaSize) != 0) return NULL;
+  return meta;
+}
+
+/* A function to point a shard of numPages frames at its per-frame arrays
+ * in meta, a block from allocMeta, each starting on a cache line.
+ */
+void carveMeta(BM_PoolInfo *pi, void *meta, int numPages) {
+  char *cursor = (char *)meta;
+
+  pi->meta = meta;
+  pi->map = (PageNumber *)carve(&cursor, sizeof(PageNumber) * numPages);
+  pi->fixCounter = (int *)carve(&cursor, sizeof(int) * numPages);
+  pi->dirtys = (bool *)carve(&cursor, sizeof(bool) * numPages);
+  pi->loading = (bool *)carve(&cursor, sizeof(bool) * numPages);
+  pi->prefetched = (bool *)carve(&cursor, sizeof(bool) * numPages);
+  pi->frames = (char **)carve(&cursor, sizeof(char *) * numPages);
+  pi->frameLatches = (pthread_rwlock_t **)carve(&cursor, sizeof(pthread_rwlock_t *) * numPages);
+  pi->lru_prev = (int *)carve(&cursor, sizeof(int) * numPages);
+  pi->lru_next = (int *)carve(&cursor, sizeof(int) * numPages);
+  pi->clock_ref = (bool *)carve(&cursor, sizeof(bool) * numPages);
+  pi->lfu_count = (int *)carve(&cursor, sizeof(int) * numPages);
+  pi->lfu_prev = (int *)carve(&cursor, sizeof(int) * numPages);
+  pi->lfu_next = (int *)carve(&cursor, sizeof(int) * numPages);
 }
 
 /* A function to initialize buffer meta data structure, which are kept in BM_PoolInfo.
+ * RC_MEM_ALLOC_FAILED, with nothing set up, if out of memory.
  */
 RC initPoolInfo(unsigned int numPages, SM_FileHandle *fh, BM_PoolInfo *pi) {
   RC rc_code = RC_OK;
+  void *meta = allocMeta(numPages);
+
+  if (meta == NULL) return RC_MEM_ALLOC_FAILED;
   pi->numPages = numPages;
   pi->fh = fh;
-  pi->dirtys = (bool *)malloc(sizeof(bool) * numPages);
-  pi->fixCounter = (int *)malloc(sizeof(int) * numPages);
-  pi->map = (PageNumber *)malloc(sizeof(PageNumber) * numPages);
+
+  carveMeta(pi, meta, numPages);
+
   pi->fifo_old = 0;
-  pi->lru_stamp = (int *)malloc(sizeof(int) * numPages);
-  pi->frames = (char **)malloc(sizeof(char *) * numPages);
+  pi->numPinned = 0;
+  pi->clock_hand = 0;
+  pi->lfu_accesses = 0;
+  pi->lruk_k = 0;
+  pi->lruk_times = NULL;
+  pi->arc_list = NULL;
+  pi->numReadIO = 0;
+  pi->numWriteIO = 0;
+  pi->numEvictionWrites = 0;
+  pi->numCleanerWrites = 0;
+  pi->numPrefetchReads = 0;
+  pi->numPins = 0;
+  pi->numUnpins = 0;
+  pi->numHits = 0;
+  pi->numMisses = 0;
+  pi->numEvictions = 0;
+  memset(pi->missLatency, 0, sizeof(pi->missLatency));
+  pi->numPrefetching = 0;
+  initPageTable(&pi->table, numPages);
+  pthread_mutex_init(&pi->latch, NULL);
+  pthread_cond_init(&pi->ioDone, NULL);
+  pthread_rwlock_init(&pi->resizeLatch, NULL);
+
+  // aligned and zeroed, so frames can be handed to SM_MODE_DIRECT files as they are;
+  // each frame holds one page of the file's own page size
+  pi->chunks = NULL;
+  pi->numChunks = 0;
+  allocChunk(pi, numPages);
 
   int i, j;
   for (i = 0; i < numPages; i++) {
     pi->dirtys[i] = false;
     pi->fixCounter[i] = 0;
+    pi->loading[i] = false;
+    pi->prefetched[i] = false;
     pi->map[i] = -1;
-    pi->lru_stamp[i] = i;
-    pi->frames[i] = malloc(sizeof(char)*PAGE_SIZE);
+    // frames start in LRU order 0 (least recent) .. numPages-1 (most recent)
+    pi->lru_prev[i] = (i == numPages - 1) ? -1 : i + 1;
+    pi->lru_next[i] = i - 1;
+    pi->clock_ref[i] = false;
+    useChunkFrame(pi, i, 0, i);
+  }
 
-    memset(pi->frames[i], 0, sizeof(( *(pi->frames[i]) ) * PAGE_SIZE));
+  pi->lru_head = numPages - 1;
+  pi->lru_tail = 0;
 
-    // for (j = 0; j < PAGE_SIZE; j++) {
-    //   pi->frames[i][j] = '\0';
-    // }
+  // all frames start in the LFU bucket of count 0
+  for (i = 0; i <= LFU_MAX_COUNT; i++) {
+    pi->lfu_head[i] = pi->lfu_tail[i] = -1;
+  }
+  for (i = 0; i < numPages; i++) {
+    pi->lfu_count[i] = 0;
+    pushFrame(pi->lfu_prev, pi->lfu_next, &pi->lfu_head[0], &pi->lfu_tail[0], i);
   }
 
   return rc_code;
 }
 
 
+/* A function to set up the LRU-K bookkeeping for k references per page.
+ * The history of up to numPages evicted pages is retained, so a page that
+ * comes back soon after its eviction is recognized.
+ */
+void initLRUK(BM_PoolInfo *pi, int k) {
+  int i, numPages = pi->numPages;
+
+  pi->lruk_k = k;
+  pi->lruk_clock = 0;
+  pi->lruk_times = (long long *)calloc(numPages * k, sizeof(long long));
+  initPageTable(&pi->lruk_table, numPages);
+  pi->lruk_pages = (PageNumber *)malloc(sizeof(PageNumber) * numPages);
+  pi->lruk_history = (long long *)malloc(sizeof(long long) * numPages * k);
+  pi->lruk_next = 0;
+  for (i = 0; i < numPages; i++) {
+    pi->lruk_pages[i] = NO_PAGE;
+  }
+}
+
+/* A function to free the LRU-K bookkeeping, if set up.
+ */
+void freeLRUK(BM_PoolInfo *pi) {
+  if (pi->lruk_times == NULL) return;
+  free(pi->lruk_times);
+  freePageTable(&pi->lruk_table);
+  free(pi->lruk_pages);
+  free(pi->lruk_history);
+  pi->lruk_times = NULL;
+}
+
+/* A function to set up the ARC bookkeeping. The ghost lists B1 and B2 hold
+ * at most numPages evicted pages together, so that many ghost slots are kept.
+ */
+void initARC(BM_PoolInfo *pi) {
+  int i, numPages = pi->numPages;
+
+  pi->arc_p = 0;
+  pi->arc_list = (int *)malloc(sizeof(int) * numPages);
+  pi->arc_prev = (int *)malloc(sizeof(int) * numPages);
+  pi->arc_next = (int *)malloc(sizeof(int) * numPages);
+  initPageTable(&pi->arc_ghosts, numPages);
+  pi->arc_ghost_page = (PageNumber *)malloc(sizeof(PageNumber) * numPages);
+  pi->arc_ghost_list = (int *)malloc(sizeof(int) * numPages);
+  pi->arc_gprev = (int *)malloc(sizeof(int) * numPages);
+  pi->arc_gnext = (int *)malloc(sizeof(int) * numPages);
+  for (i = 0; i < 2; i++) {
+    pi->arc_head[i] = pi->arc_tail[i] = -1;
+    pi->arc_ghead[i] = pi->arc_gtail[i] = -1;
+    pi->arc_size[i] = pi->arc_gsize[i] = 0;
+  }
+  for (i = 0; i < numPages; i++) {
+    pi->arc_list[i] = ARC_NONE;
+    pi->arc_gnext[i] = (i == numPages - 1) ? -1 : i + 1;
+  }
+  pi->arc_gfree = 0;
+}
+
+/* A function to free the ARC bookkeeping, if set up.
+ */
+void freeARC(BM_PoolInfo *pi) {
+  if (pi->arc_list == NULL) return;
+  free(pi->arc_list);
+  free(pi->arc_prev);
+  free(pi->arc_next);
+  freePageTable(&pi->arc_ghosts);
+  free(pi->arc_ghost_page);
+  free(pi->arc_ghost_list);
+  free(pi->arc_gprev);
+  free(pi->arc_gnext);
+  pi->arc_list = NULL;
+}
+
+/* A function to list the frames of a shard in the order the replacement
+ * strategy is likely to take them as victims: from the tail of the LRU
+ * list, from the FIFO or CLOCK position, from the lowest LFU bucket, from
+ * the tails of ARC's T1 and T2. LRU-K has no cheap order and uses the
+ * frame order. Returns the number of frames written to order.
+ */
+int victimOrder(BM_PoolInfo *pi, ReplacementStrategy strategy, int *order) {
+  int n = 0, i, c, index;
+
+  switch (strategy) {
+  case RS_LRU:
+    for (index = pi->lru_tail; index >= 0; index = pi->lru_prev[index]) order[n++] = index;
+    break;
+  case RS_FIFO:
+    for (i = 0; i < pi->numPages; i++) order[n++] = (pi->fifo_old + i) % pi->numPages;
+    break;
+  case RS_CLOCK:
+    for (i = 0; i < pi->numPages; i++) order[n++] = (pi->clock_hand + i) % pi->numPages;
+    break;
+  case RS_LFU:
+    for (c = 0; c <= LFU_MAX_COUNT; c++) {
+      for (index = pi->lfu_tail[c]; index >= 0; index = pi->lfu_prev[index]) order[n++] = index;
+    }
+    break;
+  case RS_ARC:
+    for (c = ARC_T1; c <= ARC_T2; c++) {
+      for (index = pi->arc_tail[c]; index >= 0; index = pi->arc_prev[index]) order[n++] = index;
+    }
+    break;
+  default:
+    for (i = 0; i < pi->numPages; i++) order[n++] = i;
+    break;
+  }
+  return n;
+}
+
+/* A function to find the frame of a page the caller has pinned: from its
+ * data pointer when that points at a frame of a chunk, through the page
+ * table otherwise. Returns -1 if the page is not in the pool or its frame
+ * is not pinned. The pointer needs no latch because a pinned frame keeps
+ * its page; the frame of an unpinned handle may be replaced meanwhile, so
+ * it is only trusted once the fix count shows a pin. Called with the
+ * shard's resize latch held.
+ */
+int pinnedFrame(BM_PoolInfo *const pi, BM_PageHandle *const page) {
+  uintptr_t data = (uintptr_t)page->data;
+  int pageSize = pi->fh->pageSize;
+  int c, index;
+
+  for (c = 0; c < pi->numChunks; c++) {
+    uintptr_t start = (uintptr_t)pi->chunks[c].mem;
+    if (data >= start && data < start + (uintptr_t)pi->chunks[c].numFrames * pageSize && (data - start) % pageSize == 0) {
+      index = pi->chunks[c].frameOf[(data - start) / pageSize];
+      if (index >= 0 && fixCount(pi, index) > 0 && pi->map[index] == page->pageNum) return index;
+      break;
+    }
+  }
+
+  pthread_mutex_lock(&pi->latch);
+  index = lookupPage(&pi->table, page->pageNum);
+  if (index >= 0 && fixCount(pi, index) == 0) index = -1;
+  pthread_mutex_unlock(&pi->latch);
+  return index;
+}
+
+/* A function for one cleaning round over a shard. The pages to write are
+ * chosen and pinned under the shard latch, so they are not evicted, then
+ * written outside it under their frame's shared latch, so writers using
+ * pinPageLatched are not in the middle of changing them. Like those, the
+ * frame latch is never taken with the resize latch held; the pin keeps
+ * the page in its frame if the pool is resized meanwhile.
+ */
+void cleanShard(BM_Pool *pool, BM_PoolInfo *pi, int **orderBuf, BM_PageHandle **chosenBuf, int *capacity) {
+  int n, i, index, unpinned = 0, clean = 0, wanted, numChosen = 0;
+  int *order;
+  BM_PageHandle *chosen;
+  pthread_rwlock_t *latch;
+  RC rc_code;
+
+  pthread_rwlock_rdlock(&pi->resizeLatch);
+  // the pool may have grown since the last round
+  if (*capacity < pi->numPages) {
+    *capacity = pi->numPages;
+    *orderBuf = (int *)realloc(*orderBuf, sizeof(int) * *capacity);
+    *chosenBuf = (BM_PageHandle *)realloc(*chosenBuf, sizeof(BM_PageHandle) * *capacity);
+  }
+  order = *orderBuf;
+  chosen = *chosenBuf;
+
+  pthread_mutex_lock(&pi->latch);
+  for (i = 0; i < pi->numPages; i++) {
+    if (fixCount(pi, i) == 0) {
+      unpinned++;
+      if (!pi->dirtys[i]) clean++;
+    }
+  }
+  wanted = (unpinned * pool->cleanPercent + 99) / 100 - clean;
+  if (wanted > pool->cleanMaxPages) wanted = pool->cleanMaxPages;
+  // leave a frame unpinned for the pinners meanwhile
+  if (wanted > unpinned - 1) wanted = unpinned - 1;
+
+  n = (wanted > 0) ? victimOrder(pi, pool->strategy, order) : 0;
+  for (i = 0; i < n && numChosen < wanted; i++) {
+    int index = order[i];
+    if (fixCount(pi, index) == 0 && pi->dirtys[index] && pi->map[index] != NO_PAGE) {
+      __atomic_add_fetch(&pi->fixCounter[index], 1, __ATOMIC_ACQ_REL);
+      __atomic_add_fetch(&pi->numPinned, 1, __ATOMIC_ACQ_REL);
+      pi->dirtys[index] = false;
+      chosen[numChosen].pageNum = pi->map[index];
+      chosen[numChosen++].data = pi->frames[index];
+    }
+  }
+  pthread_mutex_unlock(&pi->latch);
+  pthread_rwlock_unlock(&pi->resizeLatch);
+
+  for (i = 0; i < numChosen; i++) {
+    pthread_rwlock_rdlock(&pi->resizeLatch);
+    latch = pi->frameLatches[pinnedFrame(pi, &chosen[i])];
+    pthread_rwlock_unlock(&pi->resizeLatch);
+
+    pthread_rwlock_rdlock(latch);
+    pthread_rwlock_rdlock(pi->fileLatch);
+    rc_code = writeFrame(pi, chosen[i].pageNum, chosen[i].data);
+    pthread_rwlock_unlock(pi->fileLatch);
+    pthread_rwlock_unlock(latch);
+
+    pthread_rwlock_rdlock(&pi->resizeLatch);
+    index = pinnedFrame(pi, &chosen[i]);
+    if (rc_code == RC_OK) {
+      __atomic_add_fetch(&pi->numWriteIO, 1, __ATOMIC_RELAXED);
+      __atomic_add_fetch(&pi->numCleanerWrites, 1, __ATOMIC_RELAXED);
+    } else {
+      pi->dirtys[index] = true;
+    }
+    if (__atomic_sub_fetch(&pi->fixCounter[index], 1, __ATOMIC_ACQ_REL) == 0) {
+      __atomic_sub_fetch(&pi->numPinned, 1, __ATOMIC_ACQ_REL);
+    }
+    pthread_rwlock_unlock(&pi->resizeLatch);
+  }
+}
+
+/* The page cleaner thread: a cleaning round over every shard each
+ * cleanInterval milliseconds until stopCleaner.
+ */
+void *cleanerMain(void *arg) {
+  BM_Pool *pool = (BM_Pool *)arg;
+  int *order = NULL, capacity = 0;
+  BM_PageHandle *chosen = NULL;
+  struct timespec wake;
+  int s;
+
+  pthread_mutex_lock(&pool->cleanerLock);
+  while (!pool->cleanerStop) {
+    clock_gettime(CLOCK_REALTIME, &wake);
+    wake.tv_sec += pool->cleanInterval / 1000;
+    wake.tv_nsec += (long)(pool->cleanInterval % 1000) * 1000000;
+    if (wake.tv_nsec >= 1000000000) {
+      wake.tv_sec++;
+      wake.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(&pool->cleanerWake, &pool->cleanerLock, &wake);
+    if (pool->cleanerStop) break;
+
+    pthread_mutex_unlock(&pool->cleanerLock);
+    for (s = 0; s < pool->numShards; s++) {
+      cleanShard(pool, &pool->shards[s], &order, &chosen, &capacity);
+    }
+    pthread_mutex_lock(&pool->cleanerLock);
+  }
+  pthread_mutex_unlock(&pool->cleanerLock);
+
+  free(order);
+  free(chosen);
+  return NULL;
+}
+
+/* A function to start the page cleaner of a pool, writing up to maxPages
+ * pages per shard every interval milliseconds until the clean frames are
+ * percent of the unpinned ones. An interval of 0 starts nothing.
+ */
+void startCleaner(BM_Pool *pool, int interval, int maxPages, int percent) {
+  pool->cleanInterval = interval;
+  if (pool->cleanInterval == 0) return;
+
+  pool->cleanMaxPages = maxPages;
+  pool->cleanPercent = percent;
+  pool->cleanerStop = false;
+  pthread_mutex_init(&pool->cleanerLock, NULL);
+  pthread_cond_init(&pool->cleanerWake, NULL);
+  pthread_create(&pool->cleaner, NULL, cleanerMain, pool);
+}
+
+/* A function to stop the page cleaner of a pool and wait for it, if it runs.
+ */
+void stopCleaner(BM_Pool *pool) {
+  if (pool->cleanInterval == 0) return;
+
+  pthread_mutex_lock(&pool->cleanerLock);
+  pool->cleanerStop = true;
+  pthread_cond_signal(&pool->cleanerWake);
+  pthread_mutex_unlock(&pool->cleanerLock);
+  pthread_join(pool->cleaner, NULL);
+
+  pthread_mutex_destroy(&pool->cleanerLock);
+  pthread_cond_destroy(&pool->cleanerWake);
+  pool->cleanInterval = 0;
+}
+
+/* A function to stop the prefetcher of a pool and wait for its reads in
+ * flight, if it runs. Pages queued and not started yet are not read.
+ */
+void stopPrefetcher(BM_Pool *pool) {
+  bool running;
+
+  pthread_mutex_lock(&pool->prefetchLock);
+  running = pool->prefetcherRunning;
+  pool->prefetchStop = true;
+  pool->prefetcherRunning = false;
+  pthread_cond_signal(&pool->prefetchWake);
+  pthread_mutex_unlock(&pool->prefetchLock);
+  if (running) pthread_join(pool->prefetcher, NULL);
+}
+
+/* A function to stop everything touching the frames of a pool, for a
+ * change of its frames: the prefetcher is stopped and the resize latch
+ * of every shard taken exclusively. Undone by resumePool.
+ */
+void quiescePool(BM_Pool *pool) {
+  int s;
+
+  // the prefetcher holds frames without the resize latch
+  stopPrefetcher(pool);
+  for (s = 0; s < pool->numShards; s++) {
+    pthread_rwlock_wrlock(&pool->shards[s].resizeLatch);
+  }
+}
+
+void resumePool(BM_Pool *pool) {
+  int s;
+
+  for (s = pool->numShards - 1; s >= 0; s--) {
+    pthread_rwlock_unlock(&pool->shards[s].resizeLatch);
+  }
+
+  // let prefetchPages start the prefetcher again
+  pthread_mutex_lock(&pool->prefetchLock);
+  pool->prefetchStop = false;
+  pthread_mutex_unlock(&pool->prefetchLock);
+}
+
+/* A function to free the memory of one shard.
+ */
+void free_shard(BM_PoolInfo *pi) {
+  int i;
+
+  for (i = 0; i < pi->numChunks; i++) {
+    freeChunk(&pi->chunks[i]);
+  }
+  free(pi->chunks);
+  pthread_rwlock_destroy(&pi->resizeLatch);
+  pthread_mutex_destroy(&pi->latch);
+  pthread_cond_destroy(&pi->ioDone);
+
+  // map, fixCounter, dirtys, frames and the strategy arrays
+  free(pi->meta);
+  freeLRUK(pi);
+  freeARC(pi);
+  freePageTable(&pi->table);
+}
+
 /* A function to initialize buffer pool handler.
  */
 RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, 
@@ -158,163 +1013,657 @@ RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
   bm->strategy = strategy;
   // bm->mgmtData = malloc(sizeof(BM_PoolInfo));
   
-  BM_PoolInfo *pi = (BM_PoolInfo *)malloc(sizeof(BM_PoolInfo));
+  BM_Pool *pool = (BM_Pool *)malloc(sizeof(BM_Pool));
+  int s;
+
+  pool->numShards = poolShards < numPages ? poolShards : numPages;
+  pool->shards = (BM_PoolInfo *)malloc(sizeof(BM_PoolInfo) * pool->numShards);
+  pool->fh = fHandle;
+  memset(pool->files, 0, sizeof(pool->files));
+  pool->files[0] = fHandle;
+  pthread_rwlock_init(&pool->fileLatch, NULL);
+
+  for (s = 0; s < pool->numShards; s++) {
+    BM_PoolInfo *pi = &pool->shards[s];
+
+    // the first numPages % numShards shards get one frame more
+    int frames = numPages / pool->numShards + (s < numPages % pool->numShards ? 1 : 0);
+    if((rc_code = initPoolInfo(frames, fHandle, pi)) != RC_OK) {
+      while (--s >= 0) free_shard(&pool->shards[s]);
+      free(pool->shards);
+      pthread_rwlock_destroy(&pool->fileLatch);
+      free(pool);
+      closePageFile(fHandle);
+      free(fHandle);
+      return rc_code;
+    }
+    pi->fileLatch = &pool->fileLatch;
+    pi->files = pool->files;
+
+    // stratData of RS_LRU_K points to K
+    if (strategy == RS_LRU_K) {
+      int k = (stratData != NULL && *(int *)stratData > 0) ? *(int *)stratData : LRUK_DEFAULT_K;
+      initLRUK(pi, k);
+    } else if (strategy == RS_ARC) {
+      initARC(pi);
+    }
+  }
 
-  if((rc_code = initPoolInfo(numPages, fHandle, pi)) != RC_OK) return rc_code;
-  
-  bm->mgmtData = pi;
+  pool->map = NULL;
+  if (pool->numShards > 1) {
+    pool->map = (PageNumber *)malloc(sizeof(PageNumber) * numPages);
+    pool->dirtys = (bool *)malloc(sizeof(bool) * numPages);
+    pool->fixCounts = (int *)malloc(sizeof(int) * numPages);
+  }
+
+  pool->prefetcherRunning = false;
+  pool->prefetchStop = false;
+  pool->prefetchHead = 0;
+  pool->prefetchCount = 0;
+  pthread_mutex_init(&pool->prefetchLock, NULL);
+  pthread_cond_init(&pool->prefetchWake, NULL);
 
-  NumWriteIO = 0;
-  NumReadIO = 0;
+  pool->strategy = strategy;
+  startCleaner(pool, cleanerInterval, cleanerMaxPages, cleanerPercent);
+  
+  bm->mgmtData = pool;
 
   return rc_code;
 }
 
+/* A function to get the size in bytes of the pool's pages, the page size
+ * recorded in the page file.
+ */
+int getPageSize(BM_BufferPool *const bm) {
+  BM_Pool *pool = (BM_Pool *)bm->mgmtData;
+  return pool->fh->pageSize;
+}
+
 /* A function to free buffer pool handler.
  */
 void free_pool(BM_BufferPool *bm) {
-  BM_PoolInfo *pi = (BM_PoolInfo *)bm->mgmtData;
-  SM_FileHandle *fh = (SM_FileHandle *)pi->fh;
+  BM_Pool *pool = (BM_Pool *)bm->mgmtData;
+  SM_FileHandle *fh = pool->fh;
+
+  int s;
 
   printf("Freeing %i pages...\n", bm->numPages);
-  int i;
-  for (i = 0; i < bm->numPages; i++) {
-    // printf("free(pi->frames[%d]), Page (%d)\n", i, pi->map[i]);
-    // printf("pi->frames[%i] info: %s\n", i,pi->frames[i]);
-    free(pi->frames[i]);
+  for (s = 1; s < BM_MAX_FILES; s++) {
+    if (pool->files[s] != NULL) {
+      closePageFile(pool->files[s]);
+      free(pool->files[s]);
+    }
+  }
+  for (s = 0; s < pool->numShards; s++) {
+    free_shard(&pool->shards[s]);
+  }
+  free(pool->shards);
+  pthread_rwlock_destroy(&pool->fileLatch);
+  pthread_mutex_destroy(&pool->prefetchLock);
+  pthread_cond_destroy(&pool->prefetchWake);
+  if (pool->map != NULL) {
+    free(pool->map);
+    free(pool->dirtys);
+    free(pool->fixCounts);
   }
-
-  // printf("free(pi->frames)\n");
-  free(pi->frames);
-  // printf("free(pi->map)\n");
-  free(pi->map);
-  // printf("free(pi->fixCounter)\n");
-  free(pi->fixCounter);
-  // printf("free(pi->dirtys)\n");
-  free(pi->dirtys);
-
-  free(pi->lru_stamp);
 
   // printf("free(fh->fileName) = %s\n", fh->fileName);
   // free(fh->fileName);
+  closePageFile(fh);
   free(fh);
 
-  // printf("free(pi)\n");
-  free(pi);
+  // printf("free(pool)\n");
+  free(pool);
 
 }
 
 /* A function to shut down the buffer pool, it writes all the dirty pages 
- * to the page file in disk.
+ * to the page file in disk. Returns RC_PINNED_PAGES, with the pool, its
+ * page cleaner and its prefetcher left working, if a page is pinned.
  */
 RC shutdownBufferPool(BM_BufferPool *const bm) {
   // Needs comprobation of dirty and pinned
   RC rc_code;
   bool pinned_free = true;
-  BM_PoolInfo *pi = (BM_PoolInfo *)bm->mgmtData;
+  BM_Pool *pool = (BM_Pool *)bm->mgmtData;
+  int interval = pool->cleanInterval;
 
-  rc_code = forceFlushPool(bm);
+  // the prefetcher and the cleaner pin pages for a moment, so they are
+  // stopped before looking for pins, and started again if the pool stays
+  stopPrefetcher(pool);
+  stopCleaner(pool);
 
-  int i;
+  int i, s;
 
   // for (i = 0; i < bm->numPages; i++) {
   //   printf("PAGES in LRU buffer (%d)\n", pi->map[i]);
   // }
 
 
-  for (i = 0; i < bm->numPages; i++) {
-    if (pi->fixCounter[i] != 0) {
-      printf("buffer_mrg: PINNED PAGE (%d) with fixCounter (%d)\n", pi->map[i], pi->fixCounter[i]);
-      pinned_free = false;
+  for (s = 0; s < pool->numShards; s++) {
+    BM_PoolInfo *pi = &pool->shards[s];
+    for (i = 0; i < pi->numPages; i++) {
+      if (fixCount(pi, i) != 0) {
+        printf("buffer_mrg: PINNED PAGE (%lld) with fixCounter (%d)\n", pi->map[i], pi->fixCounter[i]);
+        pinned_free = false;
+      }
     }
   }
 
   if(pinned_free) {
+    rc_code = forceFlushPool(bm);
     printf("--- Before free_pool... ---\n");
     free_pool(bm);
     
-    return RC_OK;
+    return rc_code;
 
   } else {
+    // let prefetchPages start the prefetcher again
+    pthread_mutex_lock(&pool->prefetchLock);
+    pool->prefetchStop = false;
+    pthread_mutex_unlock(&pool->prefetchLock);
+    startCleaner(pool, interval, pool->cleanMaxPages, pool->cleanPercent);
     return RC_PINNED_PAGES;
   }
 
 }
 
+/* A function to order flushed pages by key: by file, then by page number.
+ */
+static int compareFlushPages(const void *a, const void *b) {
+  PageNumber x = ((const BM_FlushPage *)a)->key, y = ((const BM_FlushPage *)b)->key;
+  return (x > y) - (x < y);
+}
+
+/* A function to finish writing a flushed page: count the write if it
+ * succeeded, mark the page dirty again if it failed, and unpin it.
+ */
+void finishFlush(BM_FlushPage *fp, RC rc_code) {
+  BM_PoolInfo *pi = fp->pi;
+  BM_PageHandle page;
+  int index;
+
+  page.pageNum = fp->key;
+  page.data = fp->data;
+  pthread_rwlock_rdlock(&pi->resizeLatch);
+  index = pinnedFrame(pi, &page);
+  if (index < 0) {
+    pthread_rwlock_unlock(&pi->resizeLatch);
+    return;
+  }
+  if (rc_code == RC_OK) __atomic_add_fetch(&pi->numWriteIO, 1, __ATOMIC_RELAXED);
+  else pi->dirtys[index] = true;
+  if (__atomic_sub_fetch(&pi->fixCounter[index], 1, __ATOMIC_ACQ_REL) == 0) {
+    __atomic_sub_fetch(&pi->numPinned, 1, __ATOMIC_ACQ_REL);
+  }
+  pthread_rwlock_unlock(&pi->resizeLatch);
+}
+
 /* A function to write all the dirty pages with fixed count 0 to the page file in disk.
+ * They are collected from every shard and pinned, so they stay in their
+ * frames, then sorted and written in runs of adjacent pages with one
+ * writeBlocks each, so a big flush is close to sequential. Pins go on
+ * meanwhile. A page is written under its frame's shared latch, like the
+ * cleaner writes; a run ends early at a page whose latch is taken, the
+ * next one waiting for it holding no other.
  */
 RC forceFlushPool(BM_BufferPool *const bm) {
   // read from buffer and write to disk only dirty pages with fixed count 0
-  RC rc_code;
+  RC rc_code, run_code;
+
+  BM_Pool *pool = (BM_Pool *)bm->mgmtData;
+  BM_FlushPage *pages = NULL;
+  SM_PageHandle mems[BM_FLUSH_RUN];
+  SM_FileHandle *fh;
+  int n = 0, i, j, k, s;
+
+  for (s = 0; s < pool->numShards; s++) {
+    BM_PoolInfo *pi = &pool->shards[s];
+
+    pthread_rwlock_rdlock(&pi->resizeLatch);
+    pages = (BM_FlushPage *)realloc(pages, sizeof(BM_FlushPage) * (n + pi->numPages));
+    pthread_mutex_lock(&pi->latch);
+    for (i = 0; i < pi->numPages; i++) {
+      if ( (fixCount(pi, i) == 0) && pi->dirtys[i] ) {
+        __atomic_add_fetch(&pi->fixCounter[i], 1, __ATOMIC_ACQ_REL);
+        __atomic_add_fetch(&pi->numPinned, 1, __ATOMIC_ACQ_REL);
+        pi->dirtys[i] = false;
+        pages[n].key = pi->map[i];
+        pages[n].data = pi->frames[i];
+        pages[n].latch = pi->frameLatches[i];
+        pages[n++].pi = pi;
+      }
+    }
+    pthread_mutex_unlock(&pi->latch);
+    pthread_rwlock_unlock(&pi->resizeLatch);
+  }
 
-  BM_PoolInfo *pi = (BM_PoolInfo *)bm->mgmtData;
+  qsort(pages, n, sizeof(BM_FlushPage), compareFlushPages);
 
-  SM_FileHandle *fHandle = pi->fh;
+  rc_code = RC_OK;
+  for (i = 0; i < n; i = j) {
+    pthread_rwlock_rdlock(pages[i].latch);
+    mems[0] = pages[i].data;
+    for (j = i + 1; j < n && j - i < BM_FLUSH_RUN && pages[j].key == pages[j - 1].key + 1 &&
+         pthread_rwlock_tryrdlock(pages[j].latch) == 0; j++) {
+      mems[j - i] = pages[j].data;
+    }
 
-  int i;
-  for (i = 0; i < bm->numPages; i++) {
-    if ( pi->dirtys[i] && (pi->fixCounter[i] == 0) ) {
-      // write page to disk
-      SM_PageHandle memPage = pi->frames[i];
+    pthread_rwlock_rdlock(&pool->fileLatch);
+    fh = fileOf(pages[i].pi, pages[i].key);
+    run_code = (fh == NULL) ? RC_FILE_HANDLE_NOT_INIT : 
+        writeBlocks(BM_PAGE_NUMBER(pages[i].key), j - i, fh, mems);
+    pthread_rwlock_unlock(&pool->fileLatch);
 
-      // printf("Writing to disk page %i\n", pi->map[i]);
-      rc_code = writeBlock(pi->map[i], pi->fh, memPage);
-      NumWriteIO++;
-      if (rc_code != RC_OK)
-        return rc_code;
-      pi->dirtys[i] = false;
+    for (k = i; k < j; k++) {
+      pthread_rwlock_unlock(pages[k].latch);
+      finishFlush(&pages[k], run_code);
     }
+    if (rc_code == RC_OK) rc_code = run_code;
   }
+  free(pages);
 
   return rc_code;
 }
 
-/* A function to update the fifo page information when needed. 
- * The function finds and updates the oldest page and replace it.
+/* A function to map an old frame index of a shard being resized to its
+ * new one; -1 stays -1.
  */
-RC readPageFIFO(BM_PoolInfo *const pi, BM_PageHandle *const page, 
-      const PageNumber pageNum) {
-  RC rc_code = RC_OK;
-
-  int max_index = pi->numPages - 1;
-  int index = pi->fifo_old;
+static int remapFrame(int *newOf, int index) {
+  return index < 0 ? -1 : newOf[index];
+}
 
-  while(pi->fixCounter[index] > 0) {
-    if (index >= max_index) {
-      index = 0;
-    } else {
-      index++;
+/* A function to resize a shard to numPages frames, with its resize latch
+ * held exclusively. The frames flagged in drop are unpinned and clean;
+ * they are given up, the others keep their memory and latch, so the pages
+ * pinned in them stay valid, and new frames come from a new chunk. Frame
+ * indexes change: the page table and the replacement state are rebuilt
+ * for the new indexes, keeping the order of the LRU, LFU and ARC lists
+ * and of the FIFO and CLOCK positions, with the new frames as the first
+ * victims. LRU-K histories of evicted pages and ARC's ghosts start over.
+ */
+void resizeShard(BM_PoolInfo *pi, ReplacementStrategy strategy, int numPages, bool *drop, void *meta) {
+  int oldPages = pi->numPages, n = 0, numNew, first, i, j, c, slot, chunk, list;
+  int *newOf = (int *)malloc(sizeof(int) * oldPages);
+  int *from = (int *)malloc(sizeof(int) * numPages); // old index of each frame, -1 if new
+  int *order = (int *)malloc(sizeof(int) * oldPages);
+  long long *lrukTimes = NULL;
+  int *arcList = NULL, *arcPrev = NULL, *arcNext = NULL;
+  BM_PoolInfo old;
+
+  // take the dropped frames out of the lists first
+  for (i = 0; i < oldPages; i++) {
+    if (!drop[i]) continue;
+    unlinkFrame(pi->lru_prev, pi->lru_next, &pi->lru_head, &pi->lru_tail, i);
+    unlinkFrame(pi->lfu_prev, pi->lfu_next, &pi->lfu_head[pi->lfu_count[i]], &pi->lfu_tail[pi->lfu_count[i]], i);
+    if (pi->arc_list != NULL && (list = pi->arc_list[i]) != ARC_NONE) {
+      unlinkFrame(pi->arc_prev, pi->arc_next, &pi->arc_head[list], &pi->arc_tail[list], i);
+      pi->arc_size[list]--;
     }
   }
 
-  SM_FileHandle *fh = pi->fh;
-  SM_PageHandle memPage = pi->frames[index];
-
-  if (pi->dirtys[index]) {
-    writeBlock(pi->map[index], fh, memPage);
-    NumWriteIO++;
-    pi->dirtys[index] = false;
+  // FIFO and CLOCK: new frames first, then the kept ones from the old
+  // position on; others: the kept frames in their order (ARC's filled
+  // frames stay in front), then new ones
+  numNew = numPages;
+  for (i = 0; i < oldPages; i++) {
+    if (!drop[i]) numNew--;
   }
-
-  // printf("buffer_mgr.readPageFIFO: before any returning code\n");
-
-  if (pageNum >= fh->totalNumPages) {
-    // printf("buffer_mgr.readPageFIFO: appending... pageNum (%d) fh->totalNumPages (%d)\n", pageNum, fh->totalNumPages);
-    rc_code = appendEmptyBlock(fh);
-    // NumWriteIO++;
-    // printf("buffer_mgr.readPageFIFO: appended returned (%d)\n", rc_code);
-
-    if (rc_code != RC_OK) return rc_code;
+  if (strategy == RS_FIFO || strategy == RS_CLOCK) {
+    first = 0;
+    n = numNew;
+    victimOrder(pi, strategy, order);
+  } else {
+    first = numPages - numNew;
+    for (i = 0; i < oldPages; i++) order[i] = i;
   }
+  for (i = 0; i < oldPages; i++) {
+    newOf[order[i]] = -1;
+    if (!drop[order[i]]) {
+      newOf[order[i]] = n;
+      from[n++] = order[i];
+    }
+  }
+  for (j = first; j < first + numNew; j++) from[j] = -1;
+
+  old = *pi;
+  carveMeta(pi, meta, numPages);
+  pi->numPages = numPages;
+  if (old.lruk_times != NULL) {
+    lrukTimes = old.lruk_times;
+    pi->lruk_times = NULL;
+    freePageTable(&pi->lruk_table);
+    free(pi->lruk_pages);
+    free(pi->lruk_history);
+    initLRUK(pi, old.lruk_k);
+    pi->lruk_clock = old.lruk_clock;
+  }
+  if (old.arc_list != NULL) {
+    arcList = old.arc_list;
+    arcPrev = old.arc_prev;
+    arcNext = old.arc_next;
+    pi->arc_list = NULL;
+    freePageTable(&pi->arc_ghosts);
+    free(pi->arc_ghost_page);
+    free(pi->arc_ghost_list);
+    free(pi->arc_gprev);
+    free(pi->arc_gnext);
+    initARC(pi);
+    pi->arc_p = (int)((long)old.arc_p * numPages / oldPages);
+    for (list = ARC_T1; list <= ARC_T2; list++) {
+      pi->arc_head[list] = remapFrame(newOf, old.arc_head[list]);
+      pi->arc_tail[list] = remapFrame(newOf, old.arc_tail[list]);
+      pi->arc_size[list] = old.arc_size[list];
+    }
+  }
+
+  // the kept frames
+  for (j = 0; j < numPages; j++) {
+    i = from[j];
+    if (i < 0) continue;
+    pi->map[j] = old.map[i];
+    pi->fixCounter[j] = old.fixCounter[i];
+    pi->dirtys[j] = old.dirtys[i];
+    pi->loading[j] = false;
+    pi->prefetched[j] = old.prefetched[i];
+    pi->frames[j] = old.frames[i];
+    pi->frameLatches[j] = old.frameLatches[i];
+    pi->lru_prev[j] = remapFrame(newOf, old.lru_prev[i]);
+    pi->lru_next[j] = remapFrame(newOf, old.lru_next[i]);
+    pi->clock_ref[j] = old.clock_ref[i];
+    pi->lfu_count[j] = old.lfu_count[i];
+    pi->lfu_prev[j] = remapFrame(newOf, old.lfu_prev[i]);
+    pi->lfu_next[j] = remapFrame(newOf, old.lfu_next[i]);
+    if (lrukTimes != NULL) {
+      memcpy(pi->lruk_times + (long)j * pi->lruk_k, lrukTimes + (long)i * pi->lruk_k, 
+          sizeof(long long) * pi->lruk_k);
+    }
+    if (arcList != NULL) {
+      // frames not filled yet are in no list, their links are unset
+      pi->arc_list[j] = arcList[i];
+      pi->arc_prev[j] = arcList[i] == ARC_NONE ? -1 : remapFrame(newOf, arcPrev[i]);
+      pi->arc_next[j] = arcList[i] == ARC_NONE ? -1 : remapFrame(newOf, arcNext[i]);
+    }
+    c = chunkOf(&old, i, &slot);
+    pi->chunks[c].frameOf[slot] = j;
+  }
+  pi->lru_head = remapFrame(newOf, old.lru_head);
+  pi->lru_tail = remapFrame(newOf, old.lru_tail);
+  for (c = 0; c <= LFU_MAX_COUNT; c++) {
+    pi->lfu_head[c] = remapFrame(newOf, old.lfu_head[c]);
+    pi->lfu_tail[c] = remapFrame(newOf, old.lfu_tail[c]);
+  }
+
+  // the dropped frames give their memory back once their chunk is unused
+  for (i = 0; i < oldPages; i++) {
+    if (!drop[i]) continue;
+    c = chunkOf(&old, i, &slot);
+    pi->chunks[c].frameOf[slot] = -1;
+    pi->chunks[c].numUsed--;
+  }
+  for (c = 0, j = 0; c < pi->numChunks; c++) {
+    if (pi->chunks[c].numUsed == 0) {
+      freeChunk(&pi->chunks[c]);
+    } else {
+      pi->chunks[j++] = pi->chunks[c];
+    }
+  }
+  pi->numChunks = j;
+
+  // the new frames, empty and the likeliest victims
+  if (numNew > 0) {
+    chunk = allocChunk(pi, numNew);
+    for (j = first; j < first + numNew; j++) {
+      pi->map[j] = NO_PAGE;
+      pi->fixCounter[j] = 0;
+      pi->dirtys[j] = false;
+      pi->loading[j] = false;
+      pi->prefetched[j] = false;
+      pi->clock_ref[j] = false;
+      pi->lfu_count[j] = 0;
+      useChunkFrame(pi, j, chunk, j - first);
+      pushFrame(pi->lru_next, pi->lru_prev, &pi->lru_tail, &pi->lru_head, j);
+      pushFrame(pi->lfu_next, pi->lfu_prev, &pi->lfu_tail[0], &pi->lfu_head[0], j);
+    }
+  }
+
+  freePageTable(&pi->table);
+  initPageTable(&pi->table, numPages);
+  for (j = 0; j < numPages; j++) {
+    if (pi->map[j] != NO_PAGE) insertPage(&pi->table, pi->map[j], j);
+  }
+  pi->fifo_old = 0;
+  pi->clock_hand = 0;
+
+  free(old.meta);
+  free(lrukTimes);
+  free(arcList);
+  free(arcPrev);
+  free(arcNext);
+  free(newOf);
+  free(from);
+  free(order);
+}
+
+/* A function to grow or shrink a buffer pool to numPages frames while it
+ * is in use, each shard by its share. Frames are added empty; shrinking
+ * gives up unpinned frames, empty ones first and then in the order the
+ * strategy would evict them, writing back the dirty ones. Pages pinned
+ * before stay pinned at the same address. Pins and unpins wait while
+ * their shard is resized, the prefetcher is stopped meanwhile, and arrays
+ * returned by the statistics interface before are no longer valid.
+ * Returns RC_PINNED_PAGES, changing nothing, if a shard has more pinned
+ * frames than it would keep, RC_MEM_ALLOC_FAILED, changing nothing, if
+ * out of memory, and RC_INVALID_POOL_SIZE if numPages is below the
+ * number of shards.
+ */
+RC resizeBufferPool(BM_BufferPool *const bm, int numPages) {
+  BM_Pool *pool = (BM_Pool *)bm->mgmtData;
+  RC rc_code = RC_OK;
+  bool **drop;
+  void **metas;
+  int *order = NULL;
+  int s, i, n, frames, wanted;
+
+  if (numPages < pool->numShards) return RC_INVALID_POOL_SIZE;
+
+  quiescePool(pool);
+  drop = (bool **)calloc(pool->numShards, sizeof(bool *));
+
+  // choose the frames to give up
+  for (s = 0; s < pool->numShards && rc_code == RC_OK; s++) {
+    BM_PoolInfo *pi = &pool->shards[s];
+
+    frames = numPages / pool->numShards + (s < numPages % pool->numShards ? 1 : 0);
+    drop[s] = (bool *)calloc(pi->numPages, sizeof(bool));
+    wanted = pi->numPages - frames;
+    if (wanted <= 0) continue;
+    if (__atomic_load_n(&pi->numPinned, __ATOMIC_ACQUIRE) > frames) {
+      rc_code = RC_PINNED_PAGES;
+      break;
+    }
+    order = (int *)realloc(order, sizeof(int) * pi->numPages);
+    for (i = 0; i < pi->numPages && wanted > 0; i++) {
+      if (fixCount(pi, i) == 0 && pi->map[i] == NO_PAGE) {
+        drop[s][i] = true;
+        wanted--;
+      }
+    }
+    n = victimOrder(pi, pool->strategy, order);
+    for (i = 0; i < n && wanted > 0; i++) {
+      if (fixCount(pi, order[i]) == 0 && !drop[s][order[i]]) {
+        drop[s][order[i]] = true;
+        wanted--;
+      }
+    }
+  }
+
+  // the new per-frame arrays, allocated before anything changes
+  metas = (void **)calloc(pool->numShards, sizeof(void *));
+  for (s = 0; s < pool->numShards && rc_code == RC_OK; s++) {
+    frames = numPages / pool->numShards + (s < numPages % pool->numShards ? 1 : 0);
+    if ((metas[s] = allocMeta(frames)) == NULL) rc_code = RC_MEM_ALLOC_FAILED;
+  }
+
+  // write the dropped dirty pages back before anything changes
+  pthread_rwlock_rdlock(&pool->fileLatch);
+  for (s = 0; s < pool->numShards && rc_code == RC_OK; s++) {
+    BM_PoolInfo *pi = &pool->shards[s];
+    for (i = 0; i < pi->numPages && rc_code == RC_OK; i++) {
+      if (drop[s][i] && pi->dirtys[i]) {
+        rc_code = writeFrame(pi, pi->map[i], pi->frames[i]);
+        if (rc_code == RC_OK) {
+          __atomic_add_fetch(&pi->numWriteIO, 1, __ATOMIC_RELAXED);
+          pi->dirtys[i] = false;
+        }
+      }
+    }
+  }
+  pthread_rwlock_unlock(&pool->fileLatch);
+
+  for (s = 0; s < pool->numShards; s++) {
+    BM_PoolInfo *pi = &pool->shards[s];
+    if (rc_code == RC_OK) {
+      frames = numPages / pool->numShards + (s < numPages % pool->numShards ? 1 : 0);
+      resizeShard(pi, pool->strategy, frames, drop[s], metas[s]);
+    } else {
+      free(metas[s]);
+    }
+    free(drop[s]);
+  }
+  free(drop);
+  free(metas);
+  free(order);
+
+  if (rc_code == RC_OK) {
+    bm->numPages = numPages;
+    if (pool->map != NULL) {
+      pool->map = (PageNumber *)realloc(pool->map, sizeof(PageNumber) * numPages);
+      pool->dirtys = (bool *)realloc(pool->dirtys, sizeof(bool) * numPages);
+      pool->fixCounts = (int *)realloc(pool->fixCounts, sizeof(int) * numPages);
+    }
+  }
+  resumePool(pool);
+
+  return rc_code;
+}
+
+/* A function to finish loading a frame claimed by loadFrame, with the
+ * pool latch held: drop the old page from the page table and wake the
+ * pinners waiting for the frame. If the I/O failed the frame keeps the
+ * old page when it was not written back, or is left empty, and is unpinned.
+ */
+void finishLoad(BM_PoolInfo *const pi, int index, const PageNumber pageNum, 
+      PageNumber old, bool written, RC rc_code) {
+  if (old != NO_PAGE) removePage(&pi->table, old);
+  if (old != NO_PAGE && rc_code == RC_OK) __atomic_add_fetch(&pi->numEvictions, 1, __ATOMIC_RELAXED);
+  if (rc_code != RC_OK) {
+    removePage(&pi->table, pageNum);
+    pi->map[index] = NO_PAGE;
+    if (!written) {
+      // the old page was not written back, keep it
+      pi->map[index] = old;
+      insertPage(&pi->table, old, index);
+      pi->dirtys[index] = true;
+    }
+    __atomic_sub_fetch(&pi->fixCounter[index], 1, __ATOMIC_ACQ_REL);
+    __atomic_sub_fetch(&pi->numPinned, 1, __ATOMIC_ACQ_REL);
+  }
+  pi->loading[index] = false;
+  pthread_cond_broadcast(&pi->ioDone);
+}
+
+/* A function to load pageNum into the unpinned frame index and pin it.
+ * The frame is written back first if dirty, and the file grows when
+ * pageNum lies past its end. Called with the pool latch held, which is
+ * released during the I/O: the frame is pinned and marked loading, and
+ * the page table maps both the old and the new page to it, so pinners of
+ * either wait for the I/O instead of loading a page twice or reading the
+ * old page before it is written back. On an error the frame keeps the old
+ * page if the write back failed, or is left empty, and is not pinned.
+ * With a NULL page the frame is only claimed, for the prefetcher, which
+ * does the I/O itself: the latch stays held and the old page and its
+ * dirty flag are left in claimedOld and claimedDirty.
+ */
+RC loadFrame(BM_PoolInfo *const pi, BM_PageHandle *const page, int index, 
+      const PageNumber pageNum) {
+  RC rc_code = RC_OK;
+
+  SM_FileHandle *fh;
+  SM_PageHandle memPage = pi->frames[index];
+  PageNumber old = pi->map[index];
+  bool dirty = pi->dirtys[index];
+  bool written = !dirty;
+
+  // claim the frame
+  pi->map[index] = pageNum;
+  insertPage(&pi->table, pageNum, index);
+  pi->loading[index] = true;
+  pi->prefetched[index] = (page == NULL);
+  pi->dirtys[index] = false;
+  __atomic_add_fetch(&pi->fixCounter[index], 1, __ATOMIC_ACQ_REL); // should go from 0 to 1...
+  __atomic_add_fetch(&pi->numPinned, 1, __ATOMIC_ACQ_REL);
+  if (page == NULL) {
+    pi->claimedOld = old;
+    pi->claimedDirty = dirty;
+    return RC_OK;
+  }
+  pthread_mutex_unlock(&pi->latch);
+
+  pthread_rwlock_rdlock(pi->fileLatch);
+  if (dirty) {
+    rc_code = writeFrame(pi, old, memPage);
+    written = (rc_code == RC_OK);
+    if (written) {
+      __atomic_add_fetch(&pi->numWriteIO, 1, __ATOMIC_RELAXED);
+      __atomic_add_fetch(&pi->numEvictionWrites, 1, __ATOMIC_RELAXED);
+    }
+  }
+
+  // the file stays registered while its pages are being pinned
+  fh = fileOf(pi, pageNum);
+  if (rc_code == RC_OK && fh == NULL) rc_code = RC_FILE_HANDLE_NOT_INIT;
+
+  if (rc_code == RC_OK && BM_PAGE_NUMBER(pageNum) >= fh->totalNumPages) {
+    pthread_rwlock_unlock(pi->fileLatch);
+    pthread_rwlock_wrlock(pi->fileLatch);
+    if (BM_PAGE_NUMBER(pageNum) >= fh->totalNumPages) rc_code = ensureCapacity(BM_PAGE_NUMBER(pageNum) + 1, fh);
+  }
+
+  if (rc_code == RC_OK) {
+    rc_code = readBlock(BM_PAGE_NUMBER(pageNum), fh, memPage);
+    if (rc_code == RC_OK) __atomic_add_fetch(&pi->numReadIO, 1, __ATOMIC_RELAXED);
+  }
+  pthread_rwlock_unlock(pi->fileLatch);
+
+  pthread_mutex_lock(&pi->latch);
+  if (rc_code == RC_OK) page->data = memPage;
+  finishLoad(pi, index, pageNum, old, written, rc_code);
+
+  return rc_code;
+}
+
+/* A function to update the fifo page information when needed. 
+ * The function finds and updates the oldest page and replace it.
+ */
+RC readPageFIFO(BM_PoolInfo *const pi, BM_PageHandle *const page, 
+      const PageNumber pageNum) {
+  RC rc_code;
+
+  int max_index = pi->numPages - 1;
+  int index = pi->fifo_old;
+
+  while(fixCount(pi, index) > 0) {
+    if (index >= max_index) {
+      index = 0;
+    } else {
+      index++;
+    }
+  }
+
+  rc_code = loadFrame(pi, page, index, pageNum);
+  if (rc_code != RC_OK) return rc_code;
 
-  // printf("READING FROM DISK PAGE %i\n", pageNum);
-  rc_code = readBlock(pageNum, fh, memPage);
-  NumReadIO++;
-
-  page->data = memPage;
-  // update control variables
-  pi->map[index] = pageNum;
-  pi->fixCounter[index]++; // should go from 0 to 1...
   if (pi->fifo_old >= max_index) {
     pi->fifo_old = 0;
   } else {
@@ -324,103 +1673,428 @@ RC readPageFIFO(BM_PoolInfo *const pi, BM_PageHandle *const page,
   return rc_code;
 }
 
+/* A function to move frame index to the most recently used end of the LRU list.
+ */
+void update_lru(BM_PoolInfo *const pi, int index) {
+  if (pi->lru_head == index) return;
+
+  unlinkFrame(pi->lru_prev, pi->lru_next, &pi->lru_head, &pi->lru_tail, index);
+  pushFrame(pi->lru_prev, pi->lru_next, &pi->lru_head, &pi->lru_tail, index);
+}
+
 /* A function to update the lru page information when needed. 
  */
-void update_lru(int index, int *ary, int length) {
-  int max = length - 1;
-  int pointer;
+RC readPageLRU(BM_PoolInfo *const pi, BM_PageHandle *const page, 
+      const PageNumber pageNum) {
+  RC rc_code;
 
-  int *result;
-  result = malloc(sizeof(*result) * length);
+  int index = pi->lru_tail;
 
-  int i;
-  for(i = 0; i <length; i++) {
-    *(result + i) = *(ary + i);
+  // the least recently used frame nobody has pinned
+  while (index >= 0 && fixCount(pi, index) > 0) {
+    index = pi->lru_prev[index];
   }
-  
-  pointer = searchArray(max, ary, length);
-  while (( pointer != index) && max > 0) {
-    result[pointer]--;
-    max--;
-    pointer = searchArray(max, ary, length);
+  if (index < 0) return RC_PINNED_LRU;
+
+  rc_code = loadFrame(pi, page, index, pageNum);
+  if (rc_code != RC_OK) return rc_code;
+
+  update_lru(pi, index);
+
+  return rc_code;
+}
+
+/* A function to replace a page with the CLOCK (second chance) strategy.
+ * The hand sweeps the frames, passing over pinned ones and clearing the
+ * reference bit of referenced ones; the first unpinned frame found with
+ * the bit clear is replaced. The caller makes sure a frame is unpinned,
+ * so the hand stops within two sweeps.
+ */
+RC readPageCLOCK(BM_PoolInfo *const pi, BM_PageHandle *const page, 
+      const PageNumber pageNum) {
+  RC rc_code;
+
+  int index = pi->clock_hand;
+
+  while (fixCount(pi, index) > 0 || pi->clock_ref[index]) {
+    if (fixCount(pi, index) == 0) pi->clock_ref[index] = false;
+    index = (index + 1) % pi->numPages;
   }
 
-  result[index] = length - 1;
+  rc_code = loadFrame(pi, page, index, pageNum);
+  if (rc_code != RC_OK) return rc_code;
+
+  // set the reference bit and move the hand past the new page
+  pi->clock_ref[index] = true;
+  pi->clock_hand = (index + 1) % pi->numPages;
+
+  return rc_code;
+}
+
+/* A function to halve the LFU use counts, so pages that were hot a long
+ * time ago do not stay in the pool forever. Every bucket is walked from
+ * least to most recently used, keeping that order in the merged buckets.
+ */
+void age_lfu(BM_PoolInfo *const pi) {
+  int tails[LFU_MAX_COUNT + 1];
+  int c, index, prev;
 
-  for(i = 0; i <length; i++) {
-    *(ary + i) = *(result + i);
+  for (c = 0; c <= LFU_MAX_COUNT; c++) {
+    tails[c] = pi->lfu_tail[c];
+    pi->lfu_head[c] = pi->lfu_tail[c] = -1;
   }
 
-  free(result);
+  for (c = 0; c <= LFU_MAX_COUNT; c++) {
+    for (index = tails[c]; index >= 0; index = prev) {
+      prev = pi->lfu_prev[index];
+      pi->lfu_count[index] = (c + 1) / 2;
+      pushFrame(pi->lfu_prev, pi->lfu_next, &pi->lfu_head[(c + 1) / 2], 
+          &pi->lfu_tail[(c + 1) / 2], index);
+    }
+  }
+  pi->lfu_accesses = 0;
 }
 
-/* A function to update the lru page information when needed. 
+/* A function to move frame index to the bucket of count, as its most
+ * recently used frame.
  */
-RC readPageLRU(BM_PoolInfo *const pi, BM_PageHandle *const page, 
+void move_lfu(BM_PoolInfo *const pi, int index, int count) {
+  int old = pi->lfu_count[index];
+
+  unlinkFrame(pi->lfu_prev, pi->lfu_next, &pi->lfu_head[old], &pi->lfu_tail[old], index);
+  pi->lfu_count[index] = count;
+  pushFrame(pi->lfu_prev, pi->lfu_next, &pi->lfu_head[count], &pi->lfu_tail[count], index);
+
+  if (++pi->lfu_accesses >= (long)pi->numPages * LFU_AGING_PERIOD) age_lfu(pi);
+}
+
+/* A function to record a hit on frame index under LFU.
+ */
+void update_lfu(BM_PoolInfo *const pi, int index) {
+  int count = pi->lfu_count[index];
+  move_lfu(pi, index, count < LFU_MAX_COUNT ? count + 1 : count);
+}
+
+/* A function to replace the least frequently used page. Buckets are looked
+ * at from the lowest count up, each from its least recently used frame, so
+ * ties go to the least recent page.
+ */
+RC readPageLFU(BM_PoolInfo *const pi, BM_PageHandle *const page, 
       const PageNumber pageNum) {
   RC rc_code;
+  int count, index = -1;
 
-  int index = searchLowest(pi->lru_stamp, pi->numPages);
+  for (count = 0; count <= LFU_MAX_COUNT && index < 0; count++) {
+    index = pi->lfu_tail[count];
+    while (index >= 0 && fixCount(pi, index) > 0) {
+      index = pi->lfu_prev[index];
+    }
+  }
+  if (index < 0) return RC_PINNED_PAGES;
 
-  SM_FileHandle *fh = pi->fh;
-  SM_PageHandle memPage = pi->frames[index];
+  rc_code = loadFrame(pi, page, index, pageNum);
+  if (rc_code != RC_OK) return rc_code;
 
-  if (pi->fixCounter[index] > 0) return RC_PINNED_LRU;
+  move_lfu(pi, index, 1);
 
-  if (pi->dirtys[index]) {
-    writeBlock(pi->map[index], fh, memPage);
-    NumWriteIO++;
-    pi->dirtys[index] = false;
+  return rc_code;
+}
+
+/* A function to record an access to frame index under LRU-K.
+ */
+void update_lruk(BM_PoolInfo *const pi, int index) {
+  long long *times = pi->lruk_times + (long)index * pi->lruk_k;
+
+  memmove(times + 1, times, sizeof(long long) * (pi->lruk_k - 1));
+  times[0] = ++pi->lruk_clock;
+}
+
+/* A function to move LRU-K's bookkeeping of frame index from evicted, its
+ * previous page, to pageNum, just loaded into it: the access times of
+ * evicted are retained and those of pageNum restored if it was retained.
+ */
+void lruk_load(BM_PoolInfo *const pi, int index, PageNumber evicted, 
+      const PageNumber pageNum) {
+  int k = pi->lruk_k;
+  long long *times = pi->lruk_times + (long)index * k;
+  int slot;
+
+  // retain the history of the evicted page
+  if (evicted != NO_PAGE) {
+    slot = pi->lruk_next;
+    pi->lruk_next = (slot + 1) % pi->numPages;
+    if (pi->lruk_pages[slot] != NO_PAGE) removePage(&pi->lruk_table, pi->lruk_pages[slot]);
+    pi->lruk_pages[slot] = evicted;
+    memcpy(pi->lruk_history + (long)slot * k, times, sizeof(long long) * k);
+    insertPage(&pi->lruk_table, evicted, slot);
   }
 
-  if (pageNum >= fh->totalNumPages) {
-    // printf("Append for (%d) when total is (%d)\n", pageNum, fh->totalNumPages);
-    rc_code = appendEmptyBlock(fh);
-    // NumWriteIO++;
-    if (rc_code != RC_OK) return rc_code;
+  // restore the history of the loaded page, if it is still retained
+  slot = lookupPage(&pi->lruk_table, pageNum);
+  if (slot >= 0) {
+    memcpy(times, pi->lruk_history + (long)slot * k, sizeof(long long) * k);
+    removePage(&pi->lruk_table, pageNum);
+    pi->lruk_pages[slot] = NO_PAGE;
+  } else {
+    memset(times, 0, sizeof(long long) * k);
   }
+  update_lruk(pi, index);
+}
 
-  rc_code = readBlock(pageNum, fh, memPage);
-  NumReadIO++;
-  page->data = memPage;
- 
-  // update fix count and lru array
-  pi->map[index] = pageNum;
-  pi->fixCounter[index]++;
+/* A function to replace a page with LRU-K. The victim is the unpinned page
+ * whose K-th most recent access is the oldest; pages with fewer than K
+ * accesses count as infinitely old and among them the least recently used
+ * one goes first. The evicted page's access times are retained, and
+ * restored if the page is loaded again before its history slot is reused.
+ */
+RC readPageLRUK(BM_PoolInfo *const pi, BM_PageHandle *const page, 
+      const PageNumber pageNum) {
+  RC rc_code;
+  int k = pi->lruk_k;
+  int i, index = -1;
+  PageNumber evicted;
+  long long *times;
+
+  for (i = 0; i < pi->numPages; i++) {
+    if (fixCount(pi, i) > 0) continue;
+    times = pi->lruk_times + (long)i * k;
+    if (index < 0) {
+      index = i;
+      continue;
+    }
+    long long *best = pi->lruk_times + (long)index * k;
+    if (best[k - 1] != 0 && (times[k - 1] == 0 || times[k - 1] < best[k - 1])) {
+      index = i;
+    } else if (best[k - 1] == 0 && times[k - 1] == 0 && times[0] < best[0]) {
+      index = i;
+    }
+  }
+  if (index < 0) return RC_PINNED_PAGES;
 
-  update_lru(index, pi->lru_stamp, pi->numPages);
+  evicted = pi->map[index];
+
+  rc_code = loadFrame(pi, page, index, pageNum);
+  if (rc_code != RC_OK) return rc_code;
+
+  lruk_load(pi, index, evicted, pageNum);
 
   return rc_code;
-  
 }
 
-/* A function to label a page as dirty.
+/* A function to drop ghost slot from its ghost list and free it.
+ */
+void arc_forget(BM_PoolInfo *const pi, int slot) {
+  int list = pi->arc_ghost_list[slot];
+
+  unlinkFrame(pi->arc_gprev, pi->arc_gnext, &pi->arc_ghead[list], &pi->arc_gtail[list], slot);
+  pi->arc_gsize[list]--;
+  removePage(&pi->arc_ghosts, pi->arc_ghost_page[slot]);
+  pi->arc_gnext[slot] = pi->arc_gfree;
+  pi->arc_gfree = slot;
+}
+
+/* A function to remember evicted pageNum at the head of ghost list.
+ */
+void arc_remember(BM_PoolInfo *const pi, int list, PageNumber pageNum) {
+  int slot;
+
+  // B1 and B2 never outgrow the slots, this only guards against surprises
+  if (pi->arc_gfree < 0) {
+    arc_forget(pi, pi->arc_gtail[pi->arc_gsize[ARC_T1] > 0 ? ARC_T1 : ARC_T2]);
+  }
+  slot = pi->arc_gfree;
+  pi->arc_gfree = pi->arc_gnext[slot];
+
+  pi->arc_ghost_page[slot] = pageNum;
+  pi->arc_ghost_list[slot] = list;
+  pushFrame(pi->arc_gprev, pi->arc_gnext, &pi->arc_ghead[list], &pi->arc_gtail[list], slot);
+  pi->arc_gsize[list]++;
+  insertPage(&pi->arc_ghosts, pageNum, slot);
+}
+
+/* A function to find the least recently used unpinned frame of a resident
+ * list, -1 if there is none.
+ */
+int arc_victim(BM_PoolInfo *const pi, int list) {
+  int index = pi->arc_tail[list];
+
+  while (index >= 0 && fixCount(pi, index) > 0) {
+    index = pi->arc_prev[index];
+  }
+  return index;
+}
+
+/* A function to choose the frame to replace, ARC's REPLACE: T1 gives up a
+ * page while it is above its target size p, T2 otherwise. If every page of
+ * the chosen list is pinned the other list is used.
+ */
+int arc_replace(BM_PoolInfo *const pi, bool inB2) {
+  int t1 = pi->arc_size[ARC_T1];
+  int list = (t1 > 0 && (t1 > pi->arc_p || (inB2 && t1 == pi->arc_p))) ? ARC_T1 : ARC_T2;
+  int index = arc_victim(pi, list);
+
+  if (index < 0) index = arc_victim(pi, 1 - list);
+  return index;
+}
+
+/* A function to move frame index to the head of T2 after a hit.
+ */
+void update_arc(BM_PoolInfo *const pi, int index) {
+  int list = pi->arc_list[index];
+
+  unlinkFrame(pi->arc_prev, pi->arc_next, &pi->arc_head[list], &pi->arc_tail[list], index);
+  pi->arc_size[list]--;
+  pushFrame(pi->arc_prev, pi->arc_next, &pi->arc_head[ARC_T2], &pi->arc_tail[ARC_T2], index);
+  pi->arc_size[ARC_T2]++;
+  pi->arc_list[index] = ARC_T2;
+}
+
+/* A function to admit the missed pageNum to ARC: p adapts if pageNum is
+ * a ghost, which leaves its ghost list (left in ghostList, ARC_NONE if it
+ * was none), and the ghost lists are trimmed to make room for the page to
+ * be evicted. Returns the frame ARC replaces, -1 if every frame is
+ * pinned; remember is cleared if its page is dropped without a ghost.
+ */
+int arc_admit(BM_PoolInfo *const pi, const PageNumber pageNum, int *ghostList, 
+      bool *remember) {
+  int c = pi->numPages;
+  int ghost = lookupPage(&pi->arc_ghosts, pageNum);
+  int index, b1, b2;
+
+  *ghostList = ARC_NONE;
+  *remember = true;
+  if (ghost >= 0) {
+    // adapt p to the ghost hit
+    *ghostList = pi->arc_ghost_list[ghost];
+    b1 = pi->arc_gsize[ARC_T1];
+    b2 = pi->arc_gsize[ARC_T2];
+    if (*ghostList == ARC_T1) {
+      pi->arc_p += (b2 > b1) ? b2 / b1 : 1;
+      if (pi->arc_p > c) pi->arc_p = c;
+    } else {
+      pi->arc_p -= (b1 > b2) ? b1 / b2 : 1;
+      if (pi->arc_p < 0) pi->arc_p = 0;
+    }
+    arc_forget(pi, ghost);
+  }
+
+  if (pi->arc_size[ARC_T1] + pi->arc_size[ARC_T2] < c) {
+    // frames never used yet follow the listed ones. A frame emptied later
+    // (unregisterPageFile) stays listed instead, parked by coolFrame at
+    // the T1 tail with no page, and is reused as the next T1 victim;
+    // until then it counts toward |T1|, also where T1 is weighed against p
+    index = pi->arc_size[ARC_T1] + pi->arc_size[ARC_T2];
+  } else if (ghost >= 0) {
+    index = arc_replace(pi, *ghostList == ARC_T2);
+  } else if (pi->arc_size[ARC_T1] + pi->arc_gsize[ARC_T1] >= c) {
+    if (pi->arc_gsize[ARC_T1] > 0) {
+      arc_forget(pi, pi->arc_gtail[ARC_T1]);
+      index = arc_replace(pi, false);
+    } else {
+      // T1 fills the pool, its page is dropped without a ghost
+      index = arc_victim(pi, ARC_T1);
+      *remember = false;
+    }
+  } else {
+    if (c + pi->arc_gsize[ARC_T1] + pi->arc_gsize[ARC_T2] >= 2 * c && pi->arc_gsize[ARC_T2] > 0) {
+      arc_forget(pi, pi->arc_gtail[ARC_T2]);
+    }
+    index = arc_replace(pi, false);
+  }
+  return index;
+}
+
+/* A function to move frame index, about to be loaded with a page admitted
+ * by arc_admit, from its list to the head of T1, or of T2 for a page that
+ * came back from ghostList; its page is remembered in the ghost list of
+ * the list it leaves unless remember is false. The lists are updated
+ * before loadFrame lets other pinners in, so they see the frame taken.
+ */
+void arc_install(BM_PoolInfo *const pi, int index, int ghostList, bool remember) {
+  PageNumber evicted = pi->map[index];
+  int oldList = pi->arc_list[index];
+
+  if (oldList != ARC_NONE) {
+    unlinkFrame(pi->arc_prev, pi->arc_next, &pi->arc_head[oldList], &pi->arc_tail[oldList], index);
+    pi->arc_size[oldList]--;
+    if (remember && evicted != NO_PAGE) arc_remember(pi, oldList, evicted);
+  }
+
+  // a page coming back from a ghost list has been seen twice
+  pi->arc_list[index] = (ghostList != ARC_NONE) ? ARC_T2 : ARC_T1;
+  pushFrame(pi->arc_prev, pi->arc_next, &pi->arc_head[pi->arc_list[index]], 
+      &pi->arc_tail[pi->arc_list[index]], index);
+  pi->arc_size[pi->arc_list[index]]++;
+}
+
+/* A function to replace a page with ARC (adaptive replacement cache).
+ * Resident pages are split into T1, seen once recently, and T2, seen at
+ * least twice; B1 and B2 remember the pages recently evicted from each.
+ * A miss that hits B1 grows the target size p of T1, one that hits B2
+ * shrinks it, so the pool tunes itself between recency and frequency.
+ * A scan only passes through T1 and leaves the pages of T2 alone.
+ */
+RC readPageARC(BM_PoolInfo *const pi, BM_PageHandle *const page, 
+      const PageNumber pageNum) {
+  int ghostList, index;
+  bool remember;
+
+  index = arc_admit(pi, pageNum, &ghostList, &remember);
+  if (index < 0) return RC_PINNED_PAGES;
+
+  arc_install(pi, index, ghostList, remember);
+  return loadFrame(pi, page, index, pageNum);
+}
+
+/* A function to label a page as dirty. RC_PAGE_NOT_PINNED if the page
+ * is not pinned.
  */
 RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page) {
   // page->pageNum is dirty, mark it in buffer header
-  BM_PoolInfo *pi = (BM_PoolInfo *)bm->mgmtData;
-  int index = searchArray(page->pageNum, pi->map, pi->numPages);
-  pi->dirtys[index] = true;
-  return RC_OK;
+  BM_PoolInfo *pi = shardOf(bm->mgmtData, page->pageNum);
+  pthread_rwlock_rdlock(&pi->resizeLatch);
+  int index = pinnedFrame(pi, page);
+  if (index >= 0) pi->dirtys[index] = true;
+  pthread_rwlock_unlock(&pi->resizeLatch);
+  return index >= 0 ? RC_OK : RC_PAGE_NOT_PINNED;
 }
 
 /* A function to unpin a page when a user finishes using it.
+ * RC_PAGE_NOT_PINNED, changing nothing, if the page is not in the pool
+ * or not pinned anymore.
  */
 RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page) {
   // unpin the page, decrement fix count
-  BM_PoolInfo *pi = (BM_PoolInfo *)bm->mgmtData;
-  int index = searchArray(page->pageNum, pi->map, pi->numPages);
-  pi->fixCounter[index]--;
+  BM_PoolInfo *pi = shardOf(bm->mgmtData, page->pageNum);
+  int fix;
+  pthread_rwlock_rdlock(&pi->resizeLatch);
+  int index = pinnedFrame(pi, page);
+  fix = (index >= 0) ? fixCount(pi, index) : 0;
+  // never below zero, or numPinned would count the frame twice
+  do {
+    if (fix == 0) {
+      pthread_rwlock_unlock(&pi->resizeLatch);
+      return RC_PAGE_NOT_PINNED;
+    }
+  } while (!__atomic_compare_exchange_n(&pi->fixCounter[index], &fix, fix - 1, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+  if (fix == 1) {
+    __atomic_sub_fetch(&pi->numPinned, 1, __ATOMIC_ACQ_REL);
+  }
+  __atomic_add_fetch(&pi->numUnpins, 1, __ATOMIC_RELAXED);
+  pthread_rwlock_unlock(&pi->resizeLatch);
 
   // printf("buffer_mgr: unpinning page (%d) with fixCounter (%d)\n", page->pageNum, pi->fixCounter[index]);
 
   // if (bm->strategy == RS_LRU) {
-  //   pi->lru_stamp = update_lru(index, pi->lru_stamp, pi->numPages);
+  //   update_lru(pi, index);
   // }
   return RC_OK;
 }
 
-/* A function to writes a page to the disk.
+/* A function to writes a page to the disk. A page the caller has not
+ * pinned is pinned for the write, so it stays in its frame meanwhile.
+ * RC_PAGE_NOT_PINNED if the page is not in the pool.
  */
 RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page) {
   // writes page to disk
@@ -429,23 +2103,213 @@ RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page) {
   // from buffer reader, get the pointer to page and store it in memPage
   // writeBlock(page->numPage, fHandle, memPage);
   RC rc_code;
-  BM_PoolInfo *pi = (BM_PoolInfo *)bm->mgmtData;
-  SM_FileHandle *fh = pi->fh;
-  int index = searchArray(page->pageNum, pi->map, pi->numPages);
-  rc_code = writeBlock(pi->map[index], fh, pi->frames[index]);
-  NumWriteIO++;
-  if (rc_code != RC_OK)
-    return rc_code;
+  bool ownPin = false;
+  BM_PoolInfo *pi = shardOf(bm->mgmtData, page->pageNum);
+  pthread_rwlock_rdlock(&pi->resizeLatch);
+  int index = pinnedFrame(pi, page);
+  if (index < 0) {
+    pthread_mutex_lock(&pi->latch);
+    index = lookupPage(&pi->table, page->pageNum);
+    if (index >= 0 && pi->loading[index]) index = -1;
+    if (index >= 0) {
+      if (__atomic_fetch_add(&pi->fixCounter[index], 1, __ATOMIC_ACQ_REL) == 0) {
+        __atomic_add_fetch(&pi->numPinned, 1, __ATOMIC_ACQ_REL);
+      }
+      ownPin = true;
+    }
+    pthread_mutex_unlock(&pi->latch);
+  }
+  if (index < 0) {
+    pthread_rwlock_unlock(&pi->resizeLatch);
+    return RC_PAGE_NOT_PINNED;
+  }
+  pthread_rwlock_rdlock(pi->fileLatch);
+  rc_code = writeFrame(pi, pi->map[index], pi->frames[index]);
+  pthread_rwlock_unlock(pi->fileLatch);
+  if (rc_code == RC_OK) {
+    __atomic_add_fetch(&pi->numWriteIO, 1, __ATOMIC_RELAXED);
+    pi->dirtys[index] = false;
+  }
+  if (ownPin && __atomic_sub_fetch(&pi->fixCounter[index], 1, __ATOMIC_ACQ_REL) == 0) {
+    __atomic_sub_fetch(&pi->numPinned, 1, __ATOMIC_ACQ_REL);
+  }
+  pthread_rwlock_unlock(&pi->resizeLatch);
 
-  pi->dirtys[index] = false;
+  return rc_code;
+}
 
-  return RC_OK;
+/* A function to make frame index the strategy's next victim among the
+ * unpinned frames, for pages only a scan uses: the LRU tail, a clear
+ * CLOCK reference bit, LFU count 0, no LRU-K history, the tail of ARC's
+ * T1. FIFO replaces in load order whatever the use and is left alone.
+ */
+void coolFrame(BM_PoolInfo *const pi, ReplacementStrategy strategy, int index) {
+  int list;
+
+  switch (strategy)
+  {
+  case RS_LRU:
+    // pushing on the mirrored list puts the frame at the tail
+    unlinkFrame(pi->lru_prev, pi->lru_next, &pi->lru_head, &pi->lru_tail, index);
+    pushFrame(pi->lru_next, pi->lru_prev, &pi->lru_tail, &pi->lru_head, index);
+    break;
+  case RS_CLOCK:
+    pi->clock_ref[index] = false;
+    break;
+  case RS_LFU:
+    move_lfu(pi, index, 0);
+    break;
+  case RS_LRU_K:
+    memset(pi->lruk_times + (long)index * pi->lruk_k, 0, sizeof(long long) * pi->lruk_k);
+    break;
+  case RS_ARC:
+    list = pi->arc_list[index];
+    unlinkFrame(pi->arc_prev, pi->arc_next, &pi->arc_head[list], &pi->arc_tail[list], index);
+    pi->arc_size[list]--;
+    pushFrame(pi->arc_next, pi->arc_prev, &pi->arc_tail[ARC_T1], &pi->arc_head[ARC_T1], index);
+    pi->arc_size[ARC_T1]++;
+    pi->arc_list[index] = ARC_T1;
+    break;
+  default:
+    break;
+  }
+}
+
+/* A function to add the frame holding pageNum to a scan ring, in the slot
+ * after the last one used, and cool it so the pool gives it up first.
+ */
+void ringFrame(BM_PoolInfo *const pi, ReplacementStrategy strategy, BM_ScanRing *ring, 
+      int index, const PageNumber pageNum) {
+  ring->pages[ring->next] = pageNum;
+  ring->next = (ring->next + 1) % ring->size;
+  coolFrame(pi, strategy, index);
+}
+
+/* A function to load pageNum into a frame chosen by the replacement
+ * strategy, with the pool latch held; see loadFrame.
+ */
+RC readPage(BM_PoolInfo *const pi, ReplacementStrategy strategy, 
+      BM_PageHandle *const page, const PageNumber pageNum) {
+  switch (strategy)
+  {
+  case RS_FIFO:
+    return readPageFIFO(pi, page, pageNum);
+  case RS_LRU:
+    return readPageLRU(pi, page, pageNum);
+  case RS_CLOCK:
+    return readPageCLOCK(pi, page, pageNum);
+  case RS_LFU:
+    return readPageLFU(pi, page, pageNum);
+  case RS_LRU_K:
+    return readPageLRUK(pi, page, pageNum);
+  case RS_ARC:
+    return readPageARC(pi, page, pageNum);
+  default:
+    printf("Strategy not implemented: %i\n", strategy);
+    return RC_OK;
+  }
+}
+
+/* A function to load pageNum into frame index, an unpinned frame picked by
+ * a scan ring rather than by the strategy, with the pool latch held. The
+ * strategy still sees an eviction and a load, as when it picks the frame
+ * itself: ARC admits the page and remembers the evicted one in its ghost
+ * list, LRU-K retains the evicted page's history, and the other strategies
+ * record the load as their victim paths do.
+ */
+RC reuseFrame(BM_PoolInfo *const pi, ReplacementStrategy strategy, 
+      BM_PageHandle *const page, int index, const PageNumber pageNum) {
+  PageNumber evicted = pi->map[index];
+  int ghostList;
+  bool remember;
+  RC rc_code;
+
+  if (strategy == RS_ARC) {
+    arc_admit(pi, pageNum, &ghostList, &remember);
+    arc_install(pi, index, ghostList, remember);
+  }
+
+  rc_code = loadFrame(pi, page, index, pageNum);
+  if (rc_code != RC_OK) return rc_code;
+
+  if (strategy == RS_LRU) {
+    update_lru(pi, index);
+  } else if (strategy == RS_CLOCK) {
+    pi->clock_ref[index] = true;
+  } else if (strategy == RS_LFU) {
+    move_lfu(pi, index, 1);
+  } else if (strategy == RS_LRU_K) {
+    lruk_load(pi, index, evicted, pageNum);
+  }
+
+  return rc_code;
+}
+
+/* A function to load pageNum for a scan, with the pool latch held. Once
+ * the ring is full, the frame of the oldest ring page of this shard that
+ * is still resident and unpinned is reused, whatever the strategy would
+ * pick; before that, or if there is none, the strategy picks as usual.
+ */
+RC readPageRing(BM_BufferPool *const bm, BM_PoolInfo *const pi, BM_ScanRing *ring, 
+      BM_PageHandle *const page, const PageNumber pageNum) {
+  RC rc_code;
+  int i, slot, index = -1;
+  PageNumber ringPage;
+
+  for (i = 0; i < ring->size && ring->pages[ring->next] != NO_PAGE && index < 0; i++) {
+    slot = (ring->next + i) % ring->size;
+    ringPage = ring->pages[slot];
+    if (ringPage == NO_PAGE || ringPage == pageNum || shardOf(bm->mgmtData, ringPage) != pi) continue;
+    index = lookupPage(&pi->table, ringPage);
+    if (index >= 0 && (pi->loading[index] || fixCount(pi, index) > 0)) index = -1;
+    if (index >= 0) ring->next = slot;
+  }
+
+  if (index >= 0) {
+    rc_code = reuseFrame(pi, bm->strategy, page, index, pageNum);
+  } else {
+    rc_code = readPage(pi, bm->strategy, page, pageNum);
+    index = lookupPage(&pi->table, pageNum);
+  }
+  if (rc_code == RC_OK) ringFrame(pi, bm->strategy, ring, index, pageNum);
+
+  return rc_code;
+}
+
+/* A function to count a miss of a shard in its latency histogram, the
+ * miss having started at start.
+ */
+void countMiss(BM_PoolInfo *const pi, struct timespec *start) {
+  struct timespec end;
+  long long ns;
+  int bucket;
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  ns = (end.tv_sec - start->tv_sec) * 1000000000LL + (end.tv_nsec - start->tv_nsec);
+  bucket = ns > 1 ? 63 - __builtin_clzll((unsigned long long)ns) : 0;
+  if (bucket >= BM_LATENCY_BUCKETS) bucket = BM_LATENCY_BUCKETS - 1;
+
+  __atomic_add_fetch(&pi->numMisses, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&pi->missLatency[bucket], 1, __ATOMIC_RELAXED);
 }
 
 /* A function to pin a page when a user starts using it.
  */
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
 	    const PageNumber pageNum) {
+  return pinPageRing(bm, page, pageNum, NULL);
+}
+
+/* A function to pin a page for a scan: pages the scan has to load go
+ * through the frames of ring, recycled among themselves, instead of
+ * taking frames from the rest of the pool. Pages already resident are hit
+ * as with pinPage; so are pages the prefetcher loaded, which join the ring
+ * unless someone pinned them before. The first pin of a prefetched page is
+ * its first reference for the strategy, the load having recorded it
+ * already. A NULL ring is plain pinPage.
+ */
+RC pinPageRing (BM_BufferPool *const bm, BM_PageHandle *const page, 
+	    const PageNumber pageNum, BM_ScanRing *ring) {
   // read header from mgmtData
   // if pageNum already in mgmtData retrieve page pointer to page handler (page)
   // else apply strategy
@@ -457,53 +2321,484 @@ RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page,
 
   page->pageNum = pageNum;
 
-  BM_PoolInfo *pi = (BM_PoolInfo *)bm->mgmtData;
+  BM_PoolInfo *pi = shardOf(bm->mgmtData, pageNum);
+  struct timespec start;
+  int index;
 
-  int index = searchArray(pageNum, pi->map, bm->numPages);
+  pthread_rwlock_rdlock(&pi->resizeLatch);
+  pthread_mutex_lock(&pi->latch);
 
-  if (pageNum > 1000) {
-    printf("Pinning P A G E  (%d)  ! ! !\n", pageNum);
-    raise(SIGINT);
+  // a loading frame may hold another page once its I/O is done, and frames
+  // the prefetcher is reading are only pinned until then: look again then
+  while (((index = lookupPage(&pi->table, pageNum)) >= 0 && pi->loading[index]) ||
+         (index < 0 && pi->numPrefetching > 0 &&
+          __atomic_load_n(&pi->numPinned, __ATOMIC_ACQUIRE) == pi->numPages)) {
+    pthread_cond_wait(&pi->ioDone, &pi->latch);
   }
 
   if (index < 0) {
-    if (searchArray(0, pi->fixCounter, pi->numPages) < 0) {
+    if (__atomic_load_n(&pi->numPinned, __ATOMIC_ACQUIRE) == pi->numPages) {
+      pthread_mutex_unlock(&pi->latch);
+      pthread_rwlock_unlock(&pi->resizeLatch);
       return RC_PINNED_PAGES;
     }
 
     // Apply strategy
-    switch (bm->strategy)
-    {
-    case RS_FIFO:
-      rc_code = readPageFIFO(pi, page, pageNum);
-      break;
-    case RS_LRU:
-      rc_code = readPageLRU(pi, page, pageNum);
-      break;
-    default:
-      printf("Strategy not implemented: %i\n", bm->strategy);
-      break;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (ring == NULL) {
+      rc_code = readPage(pi, bm->strategy, page, pageNum);
+    } else {
+      rc_code = readPageRing(bm, pi, ring, page, pageNum);
     }
+    if (rc_code == RC_OK) countMiss(pi, &start);
   } else {
     // Page already on buffer frame!
     page->data = pi->frames[index];
-    pi->fixCounter[index]++;
-    if (bm->strategy == RS_LRU) {
-      update_lru(index, pi->lru_stamp, pi->numPages);
+    if (__atomic_fetch_add(&pi->fixCounter[index], 1, __ATOMIC_ACQ_REL) == 0) {
+      __atomic_add_fetch(&pi->numPinned, 1, __ATOMIC_ACQ_REL);
+    }
+    if (pi->prefetched[index]) {
+      // loading it counted as its first reference already, so this pin
+      // is not a second one
+      if (ring != NULL) ringFrame(pi, bm->strategy, ring, index, pageNum);
+    } else if (bm->strategy == RS_LRU) {
+      update_lru(pi, index);
+    } else if (bm->strategy == RS_CLOCK) {
+      pi->clock_ref[index] = true;
+    } else if (bm->strategy == RS_LFU) {
+      update_lfu(pi, index);
+    } else if (bm->strategy == RS_LRU_K) {
+      update_lruk(pi, index);
+    } else if (bm->strategy == RS_ARC) {
+      update_arc(pi, index);
     }
+    pi->prefetched[index] = false;
+    __atomic_add_fetch(&pi->numHits, 1, __ATOMIC_RELAXED);
   }
+  if (rc_code == RC_OK) __atomic_add_fetch(&pi->numPins, 1, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&pi->latch);
+  pthread_rwlock_unlock(&pi->resizeLatch);
   // printf("buffer_mgr: pinning page (%d) with fixcounter (%d)\n", pageNum, pi->fixCounter[index]);
   return rc_code;
 }
 
+/* A function to pin a page and take its frame latch, shared by any number
+ * of BM_LATCH_SHARED holders or held by one BM_LATCH_EXCLUSIVE holder.
+ * Release both with unpinPageLatched.
+ */
+RC pinPageLatched (BM_BufferPool *const bm, BM_PageHandle *const page, 
+	    const PageNumber pageNum, BM_LatchMode mode) {
+  BM_PoolInfo *pi = shardOf(bm->mgmtData, pageNum);
+  RC rc_code = pinPage(bm, page, pageNum);
+  pthread_rwlock_t *latch;
+
+  if (rc_code != RC_OK) return rc_code;
+
+  // the frame keeps its latch while pinned, even if the pool is resized
+  pthread_rwlock_rdlock(&pi->resizeLatch);
+  latch = pi->frameLatches[pinnedFrame(pi, page)];
+  pthread_rwlock_unlock(&pi->resizeLatch);
+  if (mode == BM_LATCH_EXCLUSIVE) {
+    pthread_rwlock_wrlock(latch);
+  } else {
+    pthread_rwlock_rdlock(latch);
+  }
+  return RC_OK;
+}
+
+/* A function to release the frame latch of a page pinned with
+ * pinPageLatched and unpin it. RC_PAGE_NOT_PINNED if the page is not
+ * pinned.
+ */
+RC unpinPageLatched (BM_BufferPool *const bm, BM_PageHandle *const page) {
+  BM_PoolInfo *pi = shardOf(bm->mgmtData, page->pageNum);
+  pthread_rwlock_t *latch = NULL;
+  int index;
+
+  pthread_rwlock_rdlock(&pi->resizeLatch);
+  index = pinnedFrame(pi, page);
+  if (index >= 0) latch = pi->frameLatches[index];
+  pthread_rwlock_unlock(&pi->resizeLatch);
+  if (latch == NULL) return RC_PAGE_NOT_PINNED;
+  pthread_rwlock_unlock(latch);
+  return unpinPage(bm, page);
+}
+
+/* A function to create a scan ring of numFrames frames, for pinPageRing.
+ */
+BM_ScanRing *createScanRing (int numFrames) {
+  BM_ScanRing *ring = (BM_ScanRing *)malloc(sizeof(BM_ScanRing));
+  int i;
+
+  ring->size = numFrames < 1 ? 1 : numFrames;
+  ring->next = 0;
+  ring->pages = (PageNumber *)malloc(sizeof(PageNumber) * ring->size);
+  for (i = 0; i < ring->size; i++) {
+    ring->pages[i] = NO_PAGE;
+  }
+  return ring;
+}
+
+/* A function to free a scan ring. Its pages stay in the pool.
+ */
+void freeScanRing (BM_ScanRing *ring) {
+  free(ring->pages);
+  free(ring);
+}
+
+/* A function to finish a prefetch read: drop the frame's old page, or
+ * restore it if the read failed, and unpin the frame.
+ */
+void finishPrefetch(BM_Prefetch *pf, RC rc_code) {
+  BM_PoolInfo *pi = pf->pi;
+
+  if (rc_code == RC_OK) {
+    __atomic_add_fetch(&pi->numReadIO, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&pi->numPrefetchReads, 1, __ATOMIC_RELAXED);
+  }
+
+  pthread_mutex_lock(&pi->latch);
+  finishLoad(pi, pf->index, pf->pageNum, pf->old, pf->written, rc_code);
+  if (rc_code == RC_OK && __atomic_sub_fetch(&pi->fixCounter[pf->index], 1, __ATOMIC_ACQ_REL) == 0) {
+    __atomic_sub_fetch(&pi->numPinned, 1, __ATOMIC_ACQ_REL);
+  }
+  pi->numPrefetching--;
+  pthread_mutex_unlock(&pi->latch);
+}
+
+/* A function to start prefetching pageNum: a frame is claimed for it the
+ * way a miss of pinPage claims one, written back if dirty, and read into
+ * asynchronously, or synchronously when the file has no asynchronous
+ * queue. Pages already in the pool or past the end of the file, and shards
+ * with every frame pinned, are skipped. Returns true if the read is left
+ * in flight, to be finished once reapBlocks returns pf.
+ */
+bool startPrefetch(BM_Pool *pool, BM_Prefetch *pf, PageNumber pageNum, bool async) {
+  BM_PoolInfo *pi = shardOf(pool, pageNum);
+  SM_FileHandle *fh;
+  RC rc_code = RC_OK;
+  bool past;
+
+  // files are only unregistered with the prefetcher stopped
+  pthread_rwlock_rdlock(pi->fileLatch);
+  fh = fileOf(pi, pageNum);
+  past = fh == NULL || BM_PAGE_NUMBER(pageNum) >= fh->totalNumPages;
+  pthread_rwlock_unlock(pi->fileLatch);
+  if (past) return false;
+  // only the pool's own file has an asynchronous queue
+  async = async && fh == pool->fh;
+
+  pthread_mutex_lock(&pi->latch);
+  if (lookupPage(&pi->table, pageNum) >= 0 ||
+      __atomic_load_n(&pi->numPinned, __ATOMIC_ACQUIRE) == pi->numPages ||
+      readPage(pi, pool->strategy, NULL, pageNum) != RC_OK) {
+    pthread_mutex_unlock(&pi->latch);
+    return false;
+  }
+  pf->pi = pi;
+  pf->index = lookupPage(&pi->table, pageNum);
+  pf->pageNum = pageNum;
+  pf->old = pi->claimedOld;
+  pf->written = !pi->claimedDirty;
+  pi->numPrefetching++;
+  pthread_mutex_unlock(&pi->latch);
+
+  pthread_rwlock_rdlock(pi->fileLatch);
+  if (!pf->written) {
+    rc_code = writeFrame(pi, pf->old, pi->frames[pf->index]);
+    pf->written = (rc_code == RC_OK);
+    if (pf->written) {
+      __atomic_add_fetch(&pi->numWriteIO, 1, __ATOMIC_RELAXED);
+      __atomic_add_fetch(&pi->numEvictionWrites, 1, __ATOMIC_RELAXED);
+    }
+  }
+  if (rc_code == RC_OK && async) {
+    rc_code = submitReadBlock(BM_PAGE_NUMBER(pageNum), fh, pi->frames[pf->index], pf);
+    if (rc_code == RC_OK) {
+      pthread_rwlock_unlock(pi->fileLatch);
+      return true;
+    }
+  } else if (rc_code == RC_OK) {
+    rc_code = readBlock(BM_PAGE_NUMBER(pageNum), fh, pi->frames[pf->index]);
+  }
+  pthread_rwlock_unlock(pi->fileLatch);
+
+  finishPrefetch(pf, rc_code);
+  return false;
+}
+
+/* The prefetcher thread: takes the pages queued by prefetchPages, starts
+ * reading up to BM_PREFETCH_DEPTH of them at a time through the page
+ * file's asynchronous queue, which only this thread drives, and finishes
+ * the reads as they complete, until stopPrefetcher.
+ */
+void *prefetcherMain(void *arg) {
+  BM_Pool *pool = (BM_Pool *)arg;
+  BM_Prefetch inFlight[BM_PREFETCH_DEPTH];
+  int freeSlots[BM_PREFETCH_DEPTH];
+  SM_IOCompletion done[BM_PREFETCH_DEPTH];
+  int numFree = BM_PREFETCH_DEPTH, i, n;
+  bool async = (initAsyncIO(pool->fh, BM_PREFETCH_DEPTH, SM_AIO_AUTO) == RC_OK);
+  PageNumber pageNum;
+
+  for (i = 0; i < BM_PREFETCH_DEPTH; i++) freeSlots[i] = i;
+
+  pthread_mutex_lock(&pool->prefetchLock);
+  while (true) {
+    while (!pool->prefetchStop && pool->prefetchCount == 0 && numFree == BM_PREFETCH_DEPTH) {
+      pthread_cond_wait(&pool->prefetchWake, &pool->prefetchLock);
+    }
+    // on stop the queued pages are dropped, the reads in flight finished
+    if (pool->prefetchStop) pool->prefetchCount = 0;
+    if (pool->prefetchStop && numFree == BM_PREFETCH_DEPTH) break;
+
+    while (pool->prefetchCount > 0 && numFree > 0) {
+      pageNum = pool->prefetchQueue[pool->prefetchHead];
+      pool->prefetchHead = (pool->prefetchHead + 1) % BM_PREFETCH_QUEUE;
+      pool->prefetchCount--;
+      pthread_mutex_unlock(&pool->prefetchLock);
+
+      i = freeSlots[--numFree];
+      if (!startPrefetch(pool, &inFlight[i], pageNum, async)) freeSlots[numFree++] = i;
+      pthread_mutex_lock(&pool->prefetchLock);
+    }
+
+    if (numFree < BM_PREFETCH_DEPTH) {
+      pthread_mutex_unlock(&pool->prefetchLock);
+      n = reapBlocks(pool->fh, done, BM_PREFETCH_DEPTH, true);
+      for (i = 0; i < n; i++) {
+        BM_Prefetch *pf = (BM_Prefetch *)done[i].tag;
+        finishPrefetch(pf, done[i].rc);
+        freeSlots[numFree++] = (int)(pf - inFlight);
+      }
+      if (n < 0) {
+        // the queue broke down: its reads are cancelled and failed, and
+        // later pages are read synchronously
+        shutdownAsyncIO(pool->fh);
+        async = false;
+        for (i = 0; i < BM_PREFETCH_DEPTH; i++) {
+          for (n = 0; n < numFree && freeSlots[n] != i; n++);
+          if (n < numFree) continue;
+          finishPrefetch(&inFlight[i], RC_FILE_R_W_ERROR);
+          freeSlots[numFree++] = i;
+        }
+      }
+      pthread_mutex_lock(&pool->prefetchLock);
+    }
+  }
+  pthread_mutex_unlock(&pool->prefetchLock);
+
+  if (async) shutdownAsyncIO(pool->fh);
+  return NULL;
+}
+
+/* Functions to read pages into the pool in the background, so a later
+ * pinPage of them finds them there instead of waiting for the disk. The
+ * pages are not pinned: each takes the frame a miss would, and may be
+ * replaced again before it is used. Pages already in the pool or past the
+ * end of the file are skipped. A pinPage of a page still being read waits
+ * for that read. Returns RC_ASYNC_QUEUE_FULL, with the first pages queued,
+ * when more than BM_PREFETCH_QUEUE pages are waiting, and
+ * RC_ASYNC_NOT_AVAILABLE, with none queued, while the prefetcher is
+ * stopped by quiescePool or shutdown.
+ */
+RC prefetchPages (BM_BufferPool *const bm, const PageNumber *pageNums, int numPages) {
+  BM_Pool *pool = (BM_Pool *)bm->mgmtData;
+  RC rc_code = RC_OK;
+  int i;
+
+  pthread_mutex_lock(&pool->prefetchLock);
+  if (!pool->prefetchStop) {
+    if (!pool->prefetcherRunning) {
+      pthread_create(&pool->prefetcher, NULL, prefetcherMain, pool);
+      pool->prefetcherRunning = true;
+    }
+    for (i = 0; i < numPages; i++) {
+      if (pool->prefetchCount == BM_PREFETCH_QUEUE) {
+        rc_code = RC_ASYNC_QUEUE_FULL;
+        break;
+      }
+      if (pageNums[i] < 0) continue;
+      pool->prefetchQueue[(pool->prefetchHead + pool->prefetchCount) % BM_PREFETCH_QUEUE] = pageNums[i];
+      pool->prefetchCount++;
+    }
+    pthread_cond_signal(&pool->prefetchWake);
+  } else if (numPages > 0) {
+    rc_code = RC_ASYNC_NOT_AVAILABLE;
+  }
+  pthread_mutex_unlock(&pool->prefetchLock);
+
+  return rc_code;
+}
+RC prefetchPage (BM_BufferPool *const bm, const PageNumber pageNum) {
+  return prefetchPages(bm, &pageNum, 1);
+}
+
+/* A function to add a page file to the pool, so its pages are cached in
+ * the pool's frames along with those of the pool's own file, under the
+ * same memory and replacement strategy. The file must have the pool's
+ * page size. Its id is left in fileId: its pages are pinned with the key
+ * BM_FILE_PAGE(fileId, pageNum). Registering a file registered already
+ * returns its id. RC_TOO_MANY_FILES if BM_MAX_FILES files are registered.
+ */
+RC registerPageFile(BM_BufferPool *const bm, char *pageFileName, int *fileId) {
+  BM_Pool *pool = (BM_Pool *)bm->mgmtData;
+  SM_FileHandle *fh;
+  RC rc_code;
+  int id, freeId = -1;
+
+  pthread_rwlock_rdlock(&pool->fileLatch);
+  for (id = 0; id < BM_MAX_FILES; id++) {
+    if (pool->files[id] != NULL && strcmp(pool->files[id]->fileName, pageFileName) == 0) break;
+  }
+  pthread_rwlock_unlock(&pool->fileLatch);
+  if (id < BM_MAX_FILES) {
+    *fileId = id;
+    return RC_OK;
+  }
+
+  fh = (SM_FileHandle *)malloc(sizeof(SM_FileHandle));
+  if ((rc_code = openPageFile(pageFileName, fh)) != RC_OK) {
+    free(fh);
+    return rc_code;
+  }
+  if (fh->pageSize != pool->fh->pageSize) {
+    closePageFile(fh);
+    free(fh);
+    return RC_INVALID_PAGE_SIZE;
+  }
+
+  pthread_rwlock_wrlock(&pool->fileLatch);
+  for (id = 1; id < BM_MAX_FILES && freeId < 0; id++) {
+    if (pool->files[id] == NULL) freeId = id;
+  }
+  if (freeId >= 0) pool->files[freeId] = fh;
+  pthread_rwlock_unlock(&pool->fileLatch);
+
+  if (freeId < 0) {
+    closePageFile(fh);
+    free(fh);
+    return RC_TOO_MANY_FILES;
+  }
+  *fileId = freeId;
+  return RC_OK;
+}
+
+/* A function to remove a page file added by registerPageFile: its dirty
+ * pages are written back, its pages leave the pool, their frames becoming
+ * the first victims, and the file is closed. Returns RC_PINNED_PAGES,
+ * changing nothing, while one of its pages is pinned, and
+ * RC_FILE_HANDLE_NOT_INIT for an id not registered, or the pool's own
+ * file, which stays until shutdownBufferPool.
+ */
+RC unregisterPageFile(BM_BufferPool *const bm, int fileId) {
+  BM_Pool *pool = (BM_Pool *)bm->mgmtData;
+  RC rc_code = RC_OK;
+  int s, i, slot;
+
+  if (fileId <= 0 || fileId >= BM_MAX_FILES) return RC_FILE_HANDLE_NOT_INIT;
+
+  // with no pin or load going on, no I/O of the file is in flight
+  quiescePool(pool);
+  if (pool->files[fileId] == NULL) rc_code = RC_FILE_HANDLE_NOT_INIT;
+  for (s = 0; s < pool->numShards && rc_code == RC_OK; s++) {
+    BM_PoolInfo *pi = &pool->shards[s];
+    for (i = 0; i < pi->numPages; i++) {
+      if (pi->map[i] != NO_PAGE && BM_PAGE_FILE(pi->map[i]) == fileId && fixCount(pi, i) > 0) {
+        rc_code = RC_PINNED_PAGES;
+      }
+    }
+  }
+
+  pthread_rwlock_rdlock(&pool->fileLatch);
+  for (s = 0; s < pool->numShards && rc_code == RC_OK; s++) {
+    BM_PoolInfo *pi = &pool->shards[s];
+    for (i = 0; i < pi->numPages && rc_code == RC_OK; i++) {
+      if (pi->map[i] != NO_PAGE && BM_PAGE_FILE(pi->map[i]) == fileId && pi->dirtys[i]) {
+        rc_code = writeFrame(pi, pi->map[i], pi->frames[i]);
+        if (rc_code == RC_OK) {
+          __atomic_add_fetch(&pi->numWriteIO, 1, __ATOMIC_RELAXED);
+          pi->dirtys[i] = false;
+        }
+      }
+    }
+  }
+  pthread_rwlock_unlock(&pool->fileLatch);
+
+  for (s = 0; s < pool->numShards && rc_code == RC_OK; s++) {
+    BM_PoolInfo *pi = &pool->shards[s];
+    for (i = 0; i < pi->numPages; i++) {
+      if (pi->map[i] != NO_PAGE && BM_PAGE_FILE(pi->map[i]) == fileId) {
+        removePage(&pi->table, pi->map[i]);
+        pi->map[i] = NO_PAGE;
+        pi->prefetched[i] = false;
+        coolFrame(pi, pool->strategy, i);
+      }
+    }
+    // the file's id may be given to another file, whose pages must not
+    // inherit its history
+    if (pi->lruk_times != NULL) {
+      for (slot = 0; slot < pi->numPages; slot++) {
+        if (pi->lruk_pages[slot] != NO_PAGE && BM_PAGE_FILE(pi->lruk_pages[slot]) == fileId) {
+          removePage(&pi->lruk_table, pi->lruk_pages[slot]);
+          pi->lruk_pages[slot] = NO_PAGE;
+        }
+      }
+    }
+    if (pi->arc_list != NULL) {
+      for (i = ARC_T1; i <= ARC_T2; i++) {
+        for (slot = pi->arc_ghead[i]; slot >= 0; ) {
+          int next = pi->arc_gnext[slot];
+          if (BM_PAGE_FILE(pi->arc_ghost_page[slot]) == fileId) arc_forget(pi, slot);
+          slot = next;
+        }
+      }
+    }
+  }
+
+  if (rc_code == RC_OK) {
+    pthread_rwlock_wrlock(&pool->fileLatch);
+    closePageFile(pool->files[fileId]);
+    free(pool->files[fileId]);
+    pool->files[fileId] = NULL;
+    pthread_rwlock_unlock(&pool->fileLatch);
+  }
+  resumePool(pool);
+
+  return rc_code;
+}
+
 // Statistics Interface
+/* A function to gather the statistics arrays of all shards into the pool's
+ * arrays, frames of shard 0 first.
+ */
+void gatherShards(BM_Pool *pool) {
+  int s, i, frame = 0;
+
+  for (s = 0; s < pool->numShards; s++) {
+    BM_PoolInfo *pi = &pool->shards[s];
+    pthread_rwlock_rdlock(&pi->resizeLatch);
+    pthread_mutex_lock(&pi->latch);
+    for (i = 0; i < pi->numPages; i++, frame++) {
+      pool->map[frame] = pi->map[i];
+      pool->dirtys[frame] = pi->dirtys[i];
+      pool->fixCounts[frame] = fixCount(pi, i);
+    }
+    pthread_mutex_unlock(&pi->latch);
+    pthread_rwlock_unlock(&pi->resizeLatch);
+  }
+}
+
 /* A function to get the frame contents.
  */
 PageNumber *getFrameContents (BM_BufferPool *const bm) {
-  BM_PoolInfo *pi = (BM_PoolInfo *)bm->mgmtData;
-  PageNumber *pn = pi->map;
+  BM_Pool *pool = (BM_Pool *)bm->mgmtData;
+  PageNumber *pn = pool->shards[0].map;
 
-  printIntArray("Frames map", pn, bm->numPages);
+  if (pool->numShards > 1) {
+    gatherShards(pool);
+    pn = pool->map;
+  }
 
   return pn;
 }
@@ -511,10 +2806,13 @@ PageNumber *getFrameContents (BM_BufferPool *const bm) {
 /* A function to get the dirty flags.
  */
 bool *getDirtyFlags (BM_BufferPool *const bm) {
-  BM_PoolInfo *pi = (BM_PoolInfo *)bm->mgmtData;
-  bool *df = pi->dirtys;
-  
-  printBoolArray("Dirty pages", df, bm->numPages);
+  BM_Pool *pool = (BM_Pool *)bm->mgmtData;
+  bool *df = pool->shards[0].dirtys;
+
+  if (pool->numShards > 1) {
+    gatherShards(pool);
+    df = pool->dirtys;
+  }
 
   return df;
 }
@@ -522,17 +2820,113 @@ bool *getDirtyFlags (BM_BufferPool *const bm) {
 /* A function to get the fix counts.
  */
 int *getFixCounts (BM_BufferPool *const bm) {
-  BM_PoolInfo *pi = (BM_PoolInfo *)bm->mgmtData;
-  int *fc = pi->fixCounter;
-  
-  printIntArray("Fix count", fc, bm->numPages);
+  BM_Pool *pool = (BM_Pool *)bm->mgmtData;
+  int *fc = pool->shards[0].fixCounter;
+
+  if (pool->numShards > 1) {
+    gatherShards(pool);
+    fc = pool->fixCounts;
+  }
 
   return fc;
 }
 
+/* Functions to get the number of pages read and written since the pool
+ * was initialized, summed over its shards.
+ */
 int getNumReadIO (BM_BufferPool *const bm) {
-  return NumReadIO;
+  BM_Pool *pool = (BM_Pool *)bm->mgmtData;
+  int s, n = 0;
+  for (s = 0; s < pool->numShards; s++) {
+    n += __atomic_load_n(&pool->shards[s].numReadIO, __ATOMIC_RELAXED);
+  }
+  return n;
 }
 int getNumWriteIO (BM_BufferPool *const bm) {
-  return NumWriteIO;
+  BM_Pool *pool = (BM_Pool *)bm->mgmtData;
+  int s, n = 0;
+  for (s = 0; s < pool->numShards; s++) {
+    n += __atomic_load_n(&pool->shards[s].numWriteIO, __ATOMIC_RELAXED);
+  }
+  return n;
+}
+
+/* Functions to tell apart the writes of the page cleaner from the dirty
+ * victims written back by pinPage itself, summed over the shards.
+ */
+int getNumCleanerWrites (BM_BufferPool *const bm) {
+  BM_Pool *pool = (BM_Pool *)bm->mgmtData;
+  int s, n = 0;
+  for (s = 0; s < pool->numShards; s++) {
+    n += __atomic_load_n(&pool->shards[s].numCleanerWrites, __ATOMIC_RELAXED);
+  }
+  return n;
+}
+int getNumEvictionWrites (BM_BufferPool *const bm) {
+  BM_Pool *pool = (BM_Pool *)bm->mgmtData;
+  int s, n = 0;
+  for (s = 0; s < pool->numShards; s++) {
+    n += __atomic_load_n(&pool->shards[s].numEvictionWrites, __ATOMIC_RELAXED);
+  }
+  return n;
+}
+
+/* A function to get the number of pages read by the prefetcher, summed
+ * over the shards; they are counted in getNumReadIO too.
+ */
+int getNumPrefetchReads (BM_BufferPool *const bm) {
+  BM_Pool *pool = (BM_Pool *)bm->mgmtData;
+  int s, n = 0;
+  for (s = 0; s < pool->numShards; s++) {
+    n += __atomic_load_n(&pool->shards[s].numPrefetchReads, __ATOMIC_RELAXED);
+  }
+  return n;
+}
+
+/* A function to fill stats with the pool's counters, summed over its
+ * shards. Nothing is printed. The counters are read without locking, so
+ * with pins going on they are each current but not necessarily
+ * consistent with each other; ARC's target is read under each shard's
+ * latch.
+ */
+RC getPoolStats (BM_BufferPool *const bm, BM_PoolStats *stats) {
+  BM_Pool *pool = (BM_Pool *)bm->mgmtData;
+  int s, b;
+
+  memset(stats, 0, sizeof(BM_PoolStats));
+  for (s = 0; s < pool->numShards; s++) {
+    BM_PoolInfo *pi = &pool->shards[s];
+    stats->pins += __atomic_load_n(&pi->numPins, __ATOMIC_RELAXED);
+    stats->unpins += __atomic_load_n(&pi->numUnpins, __ATOMIC_RELAXED);
+    stats->hits += __atomic_load_n(&pi->numHits, __ATOMIC_RELAXED);
+    stats->misses += __atomic_load_n(&pi->numMisses, __ATOMIC_RELAXED);
+    stats->evictions += __atomic_load_n(&pi->numEvictions, __ATOMIC_RELAXED);
+    stats->dirtyWriteBacks += __atomic_load_n(&pi->numEvictionWrites, __ATOMIC_RELAXED);
+    stats->readIO += __atomic_load_n(&pi->numReadIO, __ATOMIC_RELAXED);
+    stats->writeIO += __atomic_load_n(&pi->numWriteIO, __ATOMIC_RELAXED);
+    stats->cleanerWrites += __atomic_load_n(&pi->numCleanerWrites, __ATOMIC_RELAXED);
+    stats->prefetchReads += __atomic_load_n(&pi->numPrefetchReads, __ATOMIC_RELAXED);
+    for (b = 0; b < BM_LATENCY_BUCKETS; b++) {
+      stats->missLatency[b] += __atomic_load_n(&pi->missLatency[b], __ATOMIC_RELAXED);
+    }
+    if (bm->strategy == RS_ARC) {
+      // p changes with the lists, under the shard latch
+      pthread_mutex_lock(&pi->latch);
+      stats->arcTarget += pi->arc_p;
+      pthread_mutex_unlock(&pi->latch);
+    }
+  }
+  if (bm->strategy != RS_ARC) stats->arcTarget = -1;
+  return RC_OK;
+}
+
+/* A function to get ARC's adaptation parameter, the target size of its
+ * recency list T1 (summed over the shards); -1 for pools not using RS_ARC.
+ * Shorthand for the arcTarget of getPoolStats.
+ */
+int getARCTarget (BM_BufferPool *const bm) {
+  BM_PoolStats stats;
+
+  getPoolStats(bm, &stats);
+  return stats.arcTarget;
 }
@@ -13,13 +13,55 @@ typedef enum ReplacementStrategy {
   RS_LRU = 1,
   RS_CLOCK = 2,
   RS_LFU = 3,
-  RS_LRU_K = 4
+  RS_LRU_K = 4,
+  RS_ARC = 5
 } ReplacementStrategy;
 
 // Data Types and Structures
-typedef int PageNumber;
 #define NO_PAGE -1
 
+// Page keys: a pool caches the pages of every page file registered with
+// it (see registerPageFile), a page being named by its file id in the top
+// bits and its page number in the file below. The pool's own file has id
+// 0, so its keys are plain page numbers. Keys go wherever the interface
+// takes a page number, and into BM_PageHandle.pageNum.
+#define BM_FILE_SHIFT 48
+#define BM_FILE_PAGE(fileId, pageNum) (((PageNumber)(fileId) << BM_FILE_SHIFT) | (PageNumber)(pageNum))
+#define BM_PAGE_FILE(key) ((int)((key) >> BM_FILE_SHIFT))
+#define BM_PAGE_NUMBER(key) ((key) & (((PageNumber)1 << BM_FILE_SHIFT) - 1))
+
+// Memory backing the frames of a buffer pool, see setHugePages
+typedef enum BM_HugePages {
+  BM_HUGE_PAGES_OFF = 0,         // aligned heap memory
+  BM_HUGE_PAGES_TRANSPARENT = 1, // 2 MB aligned mapping, transparent huge pages requested
+  BM_HUGE_PAGES_EXPLICIT = 2     // MAP_HUGETLB mapping of reserved huge pages
+} BM_HugePages;
+
+// Frame latch taken by pinPageLatched
+typedef enum BM_LatchMode {
+  BM_LATCH_SHARED = 0,    // readers, any number at a time
+  BM_LATCH_EXCLUSIVE = 1  // one writer
+} BM_LatchMode;
+
+// Counters of a buffer pool since initBufferPool, see getPoolStats
+#define BM_LATENCY_BUCKETS 32
+typedef struct BM_PoolStats {
+  long long pins;
+  long long unpins;
+  long long hits;            // pins finding their page in the pool
+  long long misses;          // pins loading their page (failed loads not counted)
+  long long evictions;       // pages replaced by another page
+  long long dirtyWriteBacks; // replaced pages written back first
+  long long readIO;
+  long long writeIO;
+  long long cleanerWrites;   // pages written by the page cleaner
+  long long prefetchReads;   // pages read by the prefetcher
+  // misses by time taken: bucket i counts misses of 2^i to 2^(i+1) ns,
+  // the last one the longer ones too
+  long long missLatency[BM_LATENCY_BUCKETS];
+  int arcTarget;             // RS_ARC: target size p of T1 over all shards; -1 otherwise
+} BM_PoolStats;
+
 typedef struct BM_BufferPool {
   char *pageFile;
   int numPages;
@@ -33,6 +75,13 @@ typedef struct BM_PageHandle {
   char *data;
 } BM_PageHandle;
 
+// Frames a scan recycles, see pinPageRing; used by one thread at a time
+typedef struct BM_ScanRing {
+  int size;
+  int next;          // slot filled or reused next
+  PageNumber *pages; // page each slot last held, NO_PAGE if none yet
+} BM_ScanRing;
+
 // convenience macros
 #define MAKE_POOL()					\
   ((BM_BufferPool *) malloc (sizeof(BM_BufferPool)))
@@ -41,18 +90,36 @@ typedef struct BM_PageHandle {
   ((BM_PageHandle *) malloc (sizeof(BM_PageHandle)))
 
 // Buffer Manager Interface Pool Handling
+// stratData: for RS_LRU_K a pointer to K (int), NULL for K = 2; ignored otherwise
 RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, 
 		  const int numPages, ReplacementStrategy strategy, 
 		  void *stratData);
 RC shutdownBufferPool(BM_BufferPool *const bm);
 RC forceFlushPool(BM_BufferPool *const bm);
+RC resizeBufferPool(BM_BufferPool *const bm, int numPages);
+RC registerPageFile(BM_BufferPool *const bm, char *pageFileName, int *fileId);
+RC unregisterPageFile(BM_BufferPool *const bm, int fileId);
+int getPageSize(BM_BufferPool *const bm);
+void setHugePages(BM_HugePages mode);
+void setPoolShards(int numShards);
+void setPageCleaner(int intervalMs, int maxPages, int cleanPercent);
 
 // Buffer Manager Interface Access Pages
+// these may be called on one pool from several threads at once
 RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
 	    const PageNumber pageNum);
+RC pinPageLatched (BM_BufferPool *const bm, BM_PageHandle *const page, 
+	    const PageNumber pageNum, BM_LatchMode mode);
+RC unpinPageLatched (BM_BufferPool *const bm, BM_PageHandle *const page);
+BM_ScanRing *createScanRing (int numFrames);
+void freeScanRing (BM_ScanRing *ring);
+RC pinPageRing (BM_BufferPool *const bm, BM_PageHandle *const page, 
+	    const PageNumber pageNum, BM_ScanRing *ring);
+RC prefetchPage (BM_BufferPool *const bm, const PageNumber pageNum);
+RC prefetchPages (BM_BufferPool *const bm, const PageNumber *pageNums, int numPages);
 
 // Statistics Interface
 PageNumber *getFrameContents (BM_BufferPool *const bm);
@@ -60,5 +127,10 @@ bool *getDirtyFlags (BM_BufferPool *const bm);
 int *getFixCounts (BM_BufferPool *const bm);
 int getNumReadIO (BM_BufferPool *const bm);
 int getNumWriteIO (BM_BufferPool *const bm);
+int getARCTarget (BM_BufferPool *const bm);
+int getNumCleanerWrites (BM_BufferPool *const bm);
+int getNumEvictionWrites (BM_BufferPool *const bm);
+int getNumPrefetchReads (BM_BufferPool *const bm);
+RC getPoolStats (BM_BufferPool *const bm, BM_PoolStats *stats);
 
 #endif
@@ -25,7 +25,7 @@ printPoolContent (BM_BufferPool *const bm)
   printf(" %i}: ", bm->numPages); 
   
   for (i = 0; i < bm->numPages; i++)
-      printf("%s[%i%s%i]", ((i == 0) ? "" : ",") , frameContent[i], (dirty[i] ? "x": " "), fixCount[i]);
+      printf("%s[%lld%s%i]", ((i == 0) ? "" : ",") , frameContent[i], (dirty[i] ? "x": " "), fixCount[i]);
   printf("\n");
 }
 
@@ -39,45 +39,69 @@ sprintPoolContent (BM_BufferPool *const bm)
   char *message;
   int pos = 0;
 
-  message = (char *) malloc(256 + (22 * bm->numPages));
+  message = (char *) malloc(256 + (32 * bm->numPages));
   frameContent = getFrameContents(bm);
   dirty = getDirtyFlags(bm);
   fixCount = getFixCounts(bm);
 
   for (i = 0; i < bm->numPages; i++)
-    pos += sprintf(message + pos, "%s[%i%s%i]", ((i == 0) ? "" : ",") , frameContent[i], (dirty[i] ? "x": " "), fixCount[i]);
+    pos += sprintf(message + pos, "%s[%lld%s%i]", ((i == 0) ? "" : ",") , frameContent[i], (dirty[i] ? "x": " "), fixCount[i]);
   
   return message;
 }
 
 
+// pages are as large as the pool's page file says
 void
-printPageContent (BM_PageHandle *const page)
+printPageContent (BM_BufferPool *const bm, BM_PageHandle *const page)
 {
+  int pageSize = getPageSize(bm);
   int i;
 
-  printf("[Page %i]\n", page->pageNum);
+  printf("[Page %lld]\n", page->pageNum);
 
-  for (i = 1; i <= PAGE_SIZE; i++)
-    printf("%02X%s%s", page->data[i], (i % 8) ? "" : " ", (i % 64) ? "" : "\n"); 
+  for (i = 1; i <= pageSize; i++)
+    printf("%02X%s%s", (unsigned char) page->data[i - 1], (i % 8) ? "" : " ", (i % 64) ? "" : "\n"); 
 }
 
 char *
-sprintPageContent (BM_PageHandle *const page)
+sprintPageContent (BM_BufferPool *const bm, BM_PageHandle *const page)
 {
+  int pageSize = getPageSize(bm);
   int i;
   char *message;
   int pos = 0;
 
-  message = (char *) malloc(30 + (2 * PAGE_SIZE) + (PAGE_SIZE % 64) + (PAGE_SIZE % 8));
-  pos += sprintf(message + pos, "[Page %i]\n", page->pageNum);
+  message = (char *) malloc(30 + (2 * pageSize) + (pageSize / 8) + (pageSize / 64) + 1);
+  pos += sprintf(message + pos, "[Page %lld]\n", page->pageNum);
 
-  for (i = 1; i <= PAGE_SIZE; i++)
-    pos += sprintf(message + pos, "%02X%s%s", page->data[i], (i % 8) ? "" : " ", (i % 64) ? "" : "\n"); 
+  for (i = 1; i <= pageSize; i++)
+    pos += sprintf(message + pos, "%02X%s%s", (unsigned char) page->data[i - 1], (i % 8) ? "" : " ", (i % 64) ? "" : "\n"); 
   
   return message;
 }
 
+void
+printPoolStats (BM_BufferPool *const bm)
+{
+  BM_PoolStats stats;
+  int i;
+
+  getPoolStats(bm, &stats);
+  printf("{");
+  printStrat(bm);
+  printf(" %i}: pins %lld unpins %lld hits %lld misses %lld evictions %lld dirty %lld"
+         " reads %lld writes %lld cleaner %lld prefetched %lld\n",
+         bm->numPages, stats.pins, stats.unpins, stats.hits, stats.misses, stats.evictions,
+         stats.dirtyWriteBacks, stats.readIO, stats.writeIO, stats.cleanerWrites, stats.prefetchReads);
+
+  printf("miss latency:");
+  for (i = 0; i < BM_LATENCY_BUCKETS; i++)
+    if (stats.missLatency[i] > 0)
+      printf(" [%lldns %lld]", 1LL << i, stats.missLatency[i]);
+  printf("\n");
+}
+
 void
 printStrat (BM_BufferPool *const bm)
 {
@@ -98,6 +122,9 @@ printStrat (BM_BufferPool *const bm)
     case RS_LRU_K:
       printf("LRU-K");
       break;
+    case RS_ARC:
+      printf("ARC p=%i", getARCTarget(bm));
+      break;
     default:
       printf("%i", bm->strategy);
       break;
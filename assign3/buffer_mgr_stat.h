@@ -5,8 +5,9 @@
 
 // debug functions
 void printPoolContent (BM_BufferPool *const bm);
-void printPageContent (BM_PageHandle *const page);
+void printPageContent (BM_BufferPool *const bm, BM_PageHandle *const page);
+void printPoolStats (BM_BufferPool *const bm);
 char *sprintPoolContent (BM_BufferPool *const bm);
-char *sprintPageContent (BM_PageHandle *const page);
+char *sprintPageContent (BM_BufferPool *const bm, BM_PageHandle *const page);
 
 #endif
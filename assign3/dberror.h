@@ -4,8 +4,12 @@
 #include "stdio.h"
 
 /* module wide constants */
+// page size of files created without an explicit size (see createPageFileWithSize)
 #define PAGE_SIZE 4096
 
+/* page numbers are 64 bit, so page files can grow past 2^31 pages */
+typedef long long PageNumber;
+
 /* return code definitions */
 typedef int RC;
 
@@ -16,9 +20,17 @@ typedef int RC;
 #define RC_FILE_HANDLE_NOT_INIT 2
 #define RC_WRITE_FAILED 3
 #define RC_READ_NON_EXISTING_PAGE 4
+#define RC_ASYNC_QUEUE_FULL 5
+#define RC_ASYNC_NOT_AVAILABLE 6
+#define RC_INVALID_PAGE_SIZE 7
+#define RC_MEM_ALLOC_FAILED 8
+#define RC_UNSUPPORTED_FORMAT 9
 
 #define RC_PINNED_PAGES 100
 #define RC_PINNED_LRU 101
+#define RC_INVALID_POOL_SIZE 102
+#define RC_TOO_MANY_FILES 103
+#define RC_PAGE_NOT_PINNED 104
 
 #define RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE 200
 #define RC_RM_EXPR_RESULT_IS_NOT_BOOLEAN 201
@@ -4,16 +4,21 @@
 #include <unistd.h>
 
 #include "buffer_mgr.h"
+#include "storage_mgr.h"
 #include "rm_serializer.c"
 
 #define PAGES_LIST 1000
+#define SCAN_PREFETCH 8 // table pages a scan has the buffer manager read ahead
+#define SCAN_RING 16    // frames a scan recycles, at most a quarter of the pool
 
 typedef struct DB_header
 {
   int numTables;
   char **tableNames;
-  int *tableHeaders;
-  int nextAvailPage;
+  PageNumber *tableHeaders;
+  PageNumber nextAvailPage;
+  PageNumber freeListHead; // first page of the free page list, 0 if empty
+  PageNumber numFreePages;
 } DB_header;
 
 typedef struct Table_Header
@@ -23,20 +28,24 @@ typedef struct Table_Header
   int nextSlot;
   int slots_per_page;
   int headerNumPages;
-  int pagesList[PAGES_LIST];
-  int headerPagesList[PAGES_LIST];
+  PageNumber pagesList[PAGES_LIST];
+  PageNumber headerPagesList[PAGES_LIST];
   bool *active; // size is numPages*slots_per_page
 } Table_Header;
 
 static BM_BufferPool *buffer_manager;
 static BM_PageHandle *page_handler_db;
+static int db_page_size = PAGE_SIZE; // page size of the database file, set by initRecordManager
 
+PageNumber allocatePage(DB_header *db_header);
+void releasePage(DB_header *db_header, PageNumber pageNum);
 char *write_db_serializer(DB_header *header);
 char *write_schema_serializer(Schema *schema);
 char *write_table_serializer(Table_Header *th, DB_header *header);
 DB_header *read_db_serializer(char *data);
 Schema *read_schema_serializer(char *data);
 Table_Header *read_table_serializer(char *data, DB_header *db_header);
+RC readRecord(RM_TableData *rel, RID id, Record *record, BM_ScanRing *ring);
 
 
 /* A function to linearly search a target integer in an integer array.
@@ -81,7 +90,7 @@ Table_Header *createTable_Header(Schema *schema) {
 
   th->schema = schema;
   
-  float slots_per_page_decimal = PAGE_SIZE / getRecordSize(schema);
+  float slots_per_page_decimal = db_page_size / getRecordSize(schema);
   th->slots_per_page = (int)slots_per_page_decimal;
   
   th->active = malloc(sizeof(*(th->active)) * th->slots_per_page);
@@ -94,7 +103,7 @@ Table_Header *createTable_Header(Schema *schema) {
 
 DB_header *createDB_header() {
   DB_header *header = malloc(sizeof(DB_header));
-  header->tableHeaders = malloc(sizeof(int) * MAX_N_TABLES);
+  header->tableHeaders = malloc(sizeof(PageNumber) * MAX_N_TABLES);
   header->tableNames = malloc(sizeof(char*) * MAX_N_TABLES);
   int i;
   for (i = 0; i < MAX_N_TABLES; i++) {
@@ -102,9 +111,54 @@ DB_header *createDB_header() {
   }
   header->numTables = 0;
   header->nextAvailPage = 1;
+  header->freeListHead = 0;
+  header->numFreePages = 0;
   return header;
 }
 
+/* Free pages are kept in a list threaded through the pages themselves: a
+ * free page starts with the number of the next free page, 0 ends the list (page 0 is
+ * the DB_header and is never free).
+ * Return a zeroed page for the caller, reusing a free page when there is one.
+ */
+PageNumber allocatePage(DB_header *db_header) {
+  PageNumber pageNum;
+  BM_PageHandle *page_handler = MAKE_PAGE_HANDLE();
+
+  if (db_header->freeListHead == 0) {
+    free(page_handler);
+    return db_header->nextAvailPage++;
+  }
+
+  pageNum = db_header->freeListHead;
+  CHECK(pinPage(buffer_manager, page_handler, pageNum));
+  memcpy(&(db_header->freeListHead), page_handler->data, sizeof(PageNumber));
+  memset(page_handler->data, 0, db_page_size);
+  CHECK(markDirty(buffer_manager, page_handler));
+  CHECK(unpinPage(buffer_manager, page_handler));
+  db_header->numFreePages--;
+
+  free(page_handler);
+  return pageNum;
+}
+
+/* Put a page no longer used by any table at the head of the free page list.
+ */
+void releasePage(DB_header *db_header, PageNumber pageNum) {
+  BM_PageHandle *page_handler = MAKE_PAGE_HANDLE();
+
+  CHECK(pinPage(buffer_manager, page_handler, pageNum));
+  memset(page_handler->data, 0, db_page_size);
+  memcpy(page_handler->data, &(db_header->freeListHead), sizeof(PageNumber));
+  CHECK(markDirty(buffer_manager, page_handler));
+  CHECK(unpinPage(buffer_manager, page_handler));
+
+  db_header->freeListHead = pageNum;
+  db_header->numFreePages++;
+
+  free(page_handler);
+}
+
 void free_db_header(DB_header *head) {
   int i;
   for (i = 0; i < MAX_N_TABLES; i++) {
@@ -143,7 +197,7 @@ RID add_record_to_header(Table_Header *th, DB_header *db_header) {
       // th->pagesList = (int *)realloc(th->pagesList, sizeof(int) * th->numPages);
     }
 
-    th->pagesList[th->numPages++] = db_header->nextAvailPage++;
+    th->pagesList[th->numPages++] = allocatePage(db_header);
 
     BM_PageHandle *page_handler_empty = MAKE_PAGE_HANDLE();
     page_handler_empty->data = "";
@@ -157,7 +211,7 @@ RID add_record_to_header(Table_Header *th, DB_header *db_header) {
       exit(rc);
     }
 
-    memset(page_handler_empty->data, 0, sizeof( *(page_handler_empty->data) ) * PAGE_SIZE);
+    memset(page_handler_empty->data, 0, sizeof( *(page_handler_empty->data) ) * db_page_size);
     CHECK(markDirty(buffer_manager, page_handler_empty));
     CHECK(unpinPage(buffer_manager, page_handler_empty));
     
@@ -188,9 +242,10 @@ RID add_record_to_header(Table_Header *th, DB_header *db_header) {
 }
 
 int getDB_HeaderSize() {
-  int size = sizeof(int) * 2; // numTables & nextAvailPage
+  int size = sizeof(int);                 // numTables
+  size += sizeof(PageNumber) * 3;         // nextAvailPage & freeListHead & numFreePages
   size += sizeof(DB_header);
-  size += sizeof(int) * MAX_N_TABLES;
+  size += sizeof(PageNumber) * MAX_N_TABLES;
   size += sizeof(char *) * MAX_N_TABLES;
   size += sizeof(char) * ATTR_SIZE *  MAX_N_TABLES;
   return size;
@@ -207,16 +262,16 @@ int getSchemaSize(Schema *schema) {
 
 int getTable_Header_Size(Table_Header *th) {
   int size = sizeof(int) * 4; // numpages & nextSlot & slots_per_page & headerNumPages
-  int max = PAGE_SIZE;
+  int max = db_page_size;
   // *pagesList and *headerPagesList
-  size += sizeof(int) * th->numPages;
-  size += sizeof(int) * th->headerNumPages;
+  size += sizeof(PageNumber) * th->numPages;
+  size += sizeof(PageNumber) * th->headerNumPages;
 
   // for now, we are only accepting 100 pages per table, no reallocation
   int i, realloc_times;
   realloc_times = (int)(th->numPages / PAGES_LIST);
   for (i = 0; i < realloc_times; i++) {
-    size += sizeof(int) * PAGES_LIST;
+    size += sizeof(PageNumber) * PAGES_LIST;
   }
   
   size += getSchemaSize(th->schema); // *schema
@@ -230,11 +285,13 @@ int getTable_Header_Size(Table_Header *th) {
 void printDB_Header(DB_header *header) {
   printf("Printing DB_header...!!!\n");
   printf("\tnumTables:\t\t%i\n", header->numTables);
-  printf("\tnextAvailPage:\t\t%i\n", header->nextAvailPage);
+  printf("\tnextAvailPage:\t\t%lld\n", header->nextAvailPage);
+  printf("\tfreeListHead:\t\t%lld\n", header->freeListHead);
+  printf("\tnumFreePages:\t\t%lld\n", header->numFreePages);
   int i;
   for (i = 0; i < header->numTables; i++) {
     printf("\ttableNames[%i]\t\t%s\n", i, header->tableNames[i]);
-    printf("\ttableHeaders[%i]\t\t%i\n", i, header->tableHeaders[i]);
+    printf("\ttableHeaders[%i]\t\t%lld\n", i, header->tableHeaders[i]);
   }
 }
 
@@ -263,10 +320,10 @@ void printTable_Header(Table_Header *th) {
   int active_size = th->numPages * th->slots_per_page;
   int i;
   for (i = 0; i < th->numPages; i++) {
-    printf("pagesList[%i]\t\t%d\n", i, th->pagesList[i]);
+    printf("pagesList[%i]\t\t%lld\n", i, th->pagesList[i]);
   }
   for (i = 0; i < th->headerNumPages; i++) {
-    printf("headerPagesList[%i]\t%d\n", i, th->headerPagesList[i]);
+    printf("headerPagesList[%i]\t%lld\n", i, th->headerPagesList[i]);
   }
   
   printf("active(falses): [");
@@ -290,6 +347,7 @@ char *write_db_serializer(DB_header *header) {
   out = malloc(sizeof(char) * size);
 
   int int_size = sizeof(int);
+  int page_size = sizeof(PageNumber);
   int str_size = sizeof(char) * ATTR_SIZE;
 
   memcpy(out, &(header->numTables), int_size);
@@ -299,11 +357,15 @@ char *write_db_serializer(DB_header *header) {
   for (i = 0; i < header->numTables; i++) {
     memcpy(out + offset, header->tableNames[i], str_size);
     offset += str_size;
-    memcpy(out + offset, &(header->tableHeaders[i]), int_size);
-    offset += int_size;
+    memcpy(out + offset, &(header->tableHeaders[i]), page_size);
+    offset += page_size;
   }
 
-  memcpy(out + offset, &(header->nextAvailPage), int_size);
+  memcpy(out + offset, &(header->nextAvailPage), page_size);
+  offset += page_size;
+  memcpy(out + offset, &(header->freeListHead), page_size);
+  offset += page_size;
+  memcpy(out + offset, &(header->numFreePages), page_size);
 
   return out;
 }
@@ -344,6 +406,7 @@ char *write_table_serializer(Table_Header *th, DB_header *db_header) {
   char *out = malloc(sizeof(char) * size);
 
   int int_size = sizeof(int);
+  int page_size = sizeof(PageNumber);
   int str_size = sizeof(int);
   int bool_size = sizeof(bool);
   int active_length = th->numPages * th->slots_per_page;
@@ -363,14 +426,14 @@ char *write_table_serializer(Table_Header *th, DB_header *db_header) {
   int i;
   for (i = 0; i < th->numPages; i++) {
   // for (i = 0; i < PAGES_LIST; i++) {
-    memcpy(out + offset, &(th->pagesList[i]), int_size);
-    offset += int_size;
+    memcpy(out + offset, &(th->pagesList[i]), page_size);
+    offset += page_size;
   }
 
   for (i = 0; i < th->headerNumPages; i++) {
   // for (i = 0; i < PAGES_LIST; i++) {
-    memcpy(out + offset, &(th->headerPagesList[i]), int_size);
-    offset += int_size;
+    memcpy(out + offset, &(th->headerPagesList[i]), page_size);
+    offset += page_size;
   }
 
   char *sch_data = write_schema_serializer(th->schema);
@@ -381,7 +444,7 @@ char *write_table_serializer(Table_Header *th, DB_header *db_header) {
   /////////////////////////////////
   // Dealing with active[]...
   /////////////////////////////////
-  int max_size = PAGE_SIZE - offset;
+  int max_size = db_page_size - offset;
 
   // We make sure we can fit booleans (2 bytes)
   int active_offset = (int)(max_size / bool_size);
@@ -402,13 +465,13 @@ char *write_table_serializer(Table_Header *th, DB_header *db_header) {
   // printf("First memcpy of active . . .  O K ! ! !\n");
   // Need more pages!!!
   bool changed = false;
-  if ((active_size + offset) > PAGE_SIZE) {
+  if ((active_size + offset) > db_page_size) {
     // printf("W_table_header_serializer... Needing more pages!!!\n");
     // use pages already used for active[]
     int j;
     for (j = 1; j < th->headerNumPages; j++) {
       // printf("W_table_header_serializer... using already used pages\n");
-      write_size = remaining_size > PAGE_SIZE ? PAGE_SIZE : remaining_size;
+      write_size = remaining_size > db_page_size ? db_page_size : remaining_size;
 
       BM_PageHandle *page_handler = MAKE_PAGE_HANDLE();
       page_handler->data = "";
@@ -427,15 +490,15 @@ char *write_table_serializer(Table_Header *th, DB_header *db_header) {
     while (remaining_size > 0) { // Need to allocate more pages
       BM_PageHandle *page_handler = MAKE_PAGE_HANDLE();
       page_handler->data = "";
-      write_size = remaining_size > PAGE_SIZE ? PAGE_SIZE : remaining_size;
+      write_size = remaining_size > db_page_size ? db_page_size : remaining_size;
       
       // printDB_Header(db_header);
       // printTable_Header(th);
       // printf("W_table_header_serializer... creating new page (%d)\n", db_header->nextAvailPage);
 
-      th->headerPagesList[th->headerNumPages++] = db_header->nextAvailPage;
+      th->headerPagesList[th->headerNumPages] = allocatePage(db_header);
     // printf("------******###### Pinning Page (%d) (w_table_serializer while loop) ######******------\n", db_header->nextAvailPage);
-      CHECK(pinPage(buffer_manager, page_handler, db_header->nextAvailPage++));
+      CHECK(pinPage(buffer_manager, page_handler, th->headerPagesList[th->headerNumPages++]));
 
       memcpy(page_handler->data, th->active + active_offset, write_size);
       active_offset += (write_size / bool_size);
@@ -502,6 +565,7 @@ DB_header *read_db_serializer(char *data) {
   DB_header *header = createDB_header();
 
   int int_size = sizeof(int);
+  int page_size = sizeof(PageNumber);
   int str_size = sizeof(char) * ATTR_SIZE;
   int offset = 0;
 
@@ -513,11 +577,15 @@ DB_header *read_db_serializer(char *data) {
     memcpy(header->tableNames[i], data + offset, str_size);
     offset += str_size;
 
-    memcpy(&(header->tableHeaders[i]), data + offset, int_size);
-    offset += int_size;
+    memcpy(&(header->tableHeaders[i]), data + offset, page_size);
+    offset += page_size;
   }
 
-  memcpy(&(header->nextAvailPage), data + offset, int_size);
+  memcpy(&(header->nextAvailPage), data + offset, page_size);
+  offset += page_size;
+  memcpy(&(header->freeListHead), data + offset, page_size);
+  offset += page_size;
+  memcpy(&(header->numFreePages), data + offset, page_size);
 
   return header;
 }
@@ -567,6 +635,7 @@ Table_Header *read_table_serializer(char *data, DB_header *db_header) {
   th->slots_per_page = 0;
 
   int int_size = sizeof(int);
+  int page_size = sizeof(PageNumber);
   int str_size = sizeof(int);
   int bool_size = sizeof(bool);
 
@@ -585,13 +654,13 @@ Table_Header *read_table_serializer(char *data, DB_header *db_header) {
 
   int i;
   for(i = 0; i < th->numPages; i++) {
-    memcpy(&(th->pagesList[i]), data + offset, int_size);
-    offset += int_size;
+    memcpy(&(th->pagesList[i]), data + offset, page_size);
+    offset += page_size;
   }
 
   for(i = 0; i < th->headerNumPages; i++) {
-    memcpy(&(th->headerPagesList[i]), data + offset, int_size);
-    offset += int_size;
+    memcpy(&(th->headerPagesList[i]), data + offset, page_size);
+    offset += page_size;
   }
 
   Schema *schema_aux = read_schema_serializer(data + offset);
@@ -607,7 +676,7 @@ Table_Header *read_table_serializer(char *data, DB_header *db_header) {
   // Dealing with active[]...
   /////////////////////////////////
   int active_size = active_length * bool_size;
-  int max_size = PAGE_SIZE - offset;
+  int max_size = db_page_size - offset;
 
   // We make sure we can fit booleans (2 bytes)
   int active_offset = (int)(max_size / bool_size);
@@ -633,7 +702,7 @@ Table_Header *read_table_serializer(char *data, DB_header *db_header) {
     int j;
     for (j = 1; j < th->headerNumPages; j++) {
       // printf("R_table_header_serializer... reading page (%d)!!!\n", th->headerPagesList[i]);
-      write_size = remaining_size > PAGE_SIZE ? PAGE_SIZE : remaining_size;
+      write_size = remaining_size > db_page_size ? db_page_size : remaining_size;
 
       BM_PageHandle *page_handler = MAKE_PAGE_HANDLE();
       page_handler->data = "";
@@ -677,21 +746,39 @@ Table_Header *read_table_serializer(char *data, DB_header *db_header) {
 // }
 
 // table and manager
+/* Start the record manager on the database file. mgmtData may point to an
+ * RM_Config choosing the file and the page size it is created with; an
+ * existing file keeps the page size recorded in it.
+ */
 RC initRecordManager (void *mgmtData) {
+  RM_Config *config = (RM_Config *)mgmtData;
   buffer_manager = MAKE_POOL();
   page_handler_db = MAKE_PAGE_HANDLE();
   page_handler_db->data = "";
 
   char *pageFileName = "testrecord.bin";
+  int pageSize = PAGE_SIZE;
+  int numFrames = 200;
+  ReplacementStrategy strategy = RS_LRU;
+  if (config != NULL && config->pageFile != NULL) pageFileName = config->pageFile;
+  if (config != NULL && config->pageSize > 0) pageSize = config->pageSize;
+  if (config != NULL && config->numFrames > 0) {
+    numFrames = config->numFrames;
+    strategy = config->strategy;
+  }
 
   if (access(pageFileName, R_OK) < 0) {
     printf("Creating PageFile...\n");
-    createPageFile(pageFileName);
+    RC rc = createPageFileWithSize(pageFileName, pageSize);
+    if (rc != RC_OK) {
+      free(buffer_manager);
+      free(page_handler_db);
+      return rc;
+    }
   }
   
-  // CHANGE THIS after testing!!!!
-  // to 100 pages (4M in memory, not too much) and RS_LRU !
-  initBufferPool(buffer_manager, pageFileName, 200, RS_LRU, NULL);
+  initBufferPool(buffer_manager, pageFileName, numFrames, strategy, NULL);
+  db_page_size = getPageSize(buffer_manager);
 
 
   CHECK(pinPage(buffer_manager, page_handler_db, 0));
@@ -720,7 +807,7 @@ RC initRecordManager (void *mgmtData) {
   CHECK(unpinPage(buffer_manager, page_handler_db));
 
   printf("InitRecord printing page_handler_db...\n");
-  printf("page_handler_db->pageNum\t\t%d\n", page_handler_db->pageNum);
+  printf("page_handler_db->pageNum\t\t%lld\n", page_handler_db->pageNum);
 
   free_db_header(db_header);
 
@@ -781,13 +868,14 @@ RC createTable (char *name, Schema *schema) {
   // to write records on this table
   // printDB_Header(db_header);
 
-  int table_page_num = db_header->nextAvailPage;
+  PageNumber table_page_num = allocatePage(db_header);
+  PageNumber first_page_num = allocatePage(db_header);
   CHECK(pinPage(buffer_manager, page_handler_table, table_page_num));
   th->headerPagesList[th->headerNumPages++] = table_page_num;
-  th->pagesList[th->numPages++] = table_page_num + 1;
+  th->pagesList[th->numPages++] = first_page_num;
   
   // creating empty page for first records
-  CHECK(pinPage(buffer_manager, page_handler_empty, table_page_num + 1));
+  CHECK(pinPage(buffer_manager, page_handler_empty, first_page_num));
   // memset(page_handler_empty->data, 0, PAGE_SIZE);
   CHECK(markDirty(buffer_manager, page_handler_empty));
   CHECK(unpinPage(buffer_manager, page_handler_empty));
@@ -796,7 +884,6 @@ RC createTable (char *name, Schema *schema) {
   db_header->tableHeaders[db_header->numTables] = table_page_num;
   strcpy(db_header->tableNames[db_header->numTables], name);
   db_header->numTables++;
-  db_header->nextAvailPage += 2;
 
   // printDB_Header(db_header);
 
@@ -838,7 +925,7 @@ RC openTable (RM_TableData *rel, char *name) {
     return RC_TABLE_NOT_FOUND;
   }
 
-  int table_page_num = db_header->tableHeaders[table_pos_in_array];
+  PageNumber table_page_num = db_header->tableHeaders[table_pos_in_array];
   
   BM_PageHandle *page_handler_table = MAKE_PAGE_HANDLE(); //page handler for the table header
   page_handler_table->data = "";
@@ -879,10 +966,28 @@ RC deleteTable (char *name) {
     return RC_TABLE_NOT_FOUND;
   }
 
+  // give the table's data and header pages back to the free page list
+  PageNumber table_page_num = db_header->tableHeaders[table_pos_in_array];
+  BM_PageHandle *page_handler_table = MAKE_PAGE_HANDLE(); //page handler for the table header
+  page_handler_table->data = "";
+  CHECK(pinPage(buffer_manager, page_handler_table, table_page_num));
+  Table_Header *th_header = read_table_serializer(page_handler_table->data, db_header);
+  CHECK(unpinPage(buffer_manager, page_handler_table));
+  free(page_handler_table);
+
   int i;
+  for (i = 0; i < th_header->numPages; i++) {
+    releasePage(db_header, th_header->pagesList[i]);
+  }
+  for (i = 0; i < th_header->headerNumPages; i++) {
+    releasePage(db_header, th_header->headerPagesList[i]);
+  }
+  freeSchema(th_header->schema);
+  free_table_header(th_header);
+
   for(i=table_pos_in_array; i<db_header->numTables-1; i++)
   {
-    db_header->tableNames[i] = db_header->tableNames[i+1];
+    strcpy(db_header->tableNames[i], db_header->tableNames[i+1]);
     db_header->tableHeaders[i] = db_header->tableHeaders[i+1];
   }
   db_header->numTables--;
@@ -899,6 +1004,29 @@ RC deleteTable (char *name) {
   return RC_OK;
 }
 
+/* Report how much of the page file is in use and how much sits on the free
+ * page list. Fills info if given and prints a summary.
+ */
+RC reportFragmentation (RM_SpaceInfo *info) {
+  RM_SpaceInfo space;
+
+  CHECK(pinPage(buffer_manager, page_handler_db, 0)); //page handler for database header
+  DB_header *db_header = read_db_serializer(page_handler_db->data);
+  CHECK(unpinPage(buffer_manager, page_handler_db));
+
+  space.totalPages = db_header->nextAvailPage;
+  space.freePages = db_header->numFreePages;
+  space.usedPages = space.totalPages - space.freePages;
+  free_db_header(db_header);
+
+  printf("Pages: %lld total, %lld in use, %lld free (%.1f%% fragmentation)\n",
+         space.totalPages, space.usedPages, space.freePages,
+         space.totalPages > 0 ? (100.0 * space.freePages) / space.totalPages : 0.0);
+
+  if (info != NULL) *info = space;
+  return RC_OK;
+}
+
 int getNumTuples (RM_TableData *rel) {
   char *tableName = rel->name; //name of the table
 
@@ -912,7 +1040,7 @@ int getNumTuples (RM_TableData *rel) {
     return RC_TABLE_NOT_FOUND;
   }
 
-  int table_page_num = db_header->tableHeaders[table_pos_in_array];
+  PageNumber table_page_num = db_header->tableHeaders[table_pos_in_array];
   
   BM_PageHandle *page_handler_table = MAKE_PAGE_HANDLE(); //page handler for the table header
   page_handler_table->data = "";
@@ -951,7 +1079,7 @@ RC insertRecord (RM_TableData *rel, Record *record) {
     return RC_TABLE_NOT_FOUND;
   }
 
-  int table_page_num = db_header->tableHeaders[table_pos_in_array];
+  PageNumber table_page_num = db_header->tableHeaders[table_pos_in_array];
   
   BM_PageHandle *page_handler_table = MAKE_PAGE_HANDLE(); //page handler for the table header
   page_handler_table->data = "";
@@ -1027,7 +1155,7 @@ RC deleteRecord (RM_TableData *rel, RID id) {
     return RC_TABLE_NOT_FOUND;
   }
 
-  int table_page_num = db_header->tableHeaders[table_pos_in_array];
+  PageNumber table_page_num = db_header->tableHeaders[table_pos_in_array];
   
   BM_PageHandle *page_handler_table = MAKE_PAGE_HANDLE(); 
   page_handler_table->data = "";
@@ -1079,7 +1207,7 @@ RC updateRecord (RM_TableData *rel, Record *record) {
     return RC_TABLE_NOT_FOUND;
   }
 
-  int table_page_num = db_header->tableHeaders[table_pos_in_array];
+  PageNumber table_page_num = db_header->tableHeaders[table_pos_in_array];
   
   BM_PageHandle *page_handler_table = MAKE_PAGE_HANDLE(); //page handler for the table header
   page_handler_table->data = "";
@@ -1122,6 +1250,14 @@ RC updateRecord (RM_TableData *rel, Record *record) {
 }
 
 RC getRecord (RM_TableData *rel, RID id, Record *record) {
+  return readRecord(rel, id, record, NULL);
+}
+
+/* A function to read record id, pinning its page through ring (see
+ * pinPageRing), so scans don't push other tables' pages out of the pool.
+ * getRecord passes no ring.
+ */
+RC readRecord (RM_TableData *rel, RID id, Record *record, BM_ScanRing *ring) {
   char *tableName = rel->name; //name of the table
 
   CHECK(pinPage(buffer_manager, page_handler_db, 0)); //page handler for database header
@@ -1134,7 +1270,7 @@ RC getRecord (RM_TableData *rel, RID id, Record *record) {
     return RC_TABLE_NOT_FOUND;
   }
 
-  int table_page_num = db_header->tableHeaders[table_pos_in_array];
+  PageNumber table_page_num = db_header->tableHeaders[table_pos_in_array];
   
   BM_PageHandle *page_handler_table = MAKE_PAGE_HANDLE(); //page handler for the table header
   page_handler_table->data = "";
@@ -1170,7 +1306,7 @@ RC getRecord (RM_TableData *rel, RID id, Record *record) {
   //page handler for the page to be written, it will always be the last page of the table
   BM_PageHandle *page_handler_reading_page = MAKE_PAGE_HANDLE(); 
   page_handler_reading_page->data = "";
-  CHECK(pinPage(buffer_manager, page_handler_reading_page, th_header->pagesList[id.page]));
+  CHECK(pinPageRing(buffer_manager, page_handler_reading_page, th_header->pagesList[id.page], ring));
 
   int recordSize = getRecordSize(th_header->schema);
   int offset = (id.slot) * recordSize;
@@ -1207,14 +1343,34 @@ typedef struct Scan_Helper
   int nextRecord;
   Table_Header *th_header;
   Expr *cond;
+  int prefetchedTo; // table pages up to this index were handed to prefetchPages
+  BM_ScanRing *ring; // frames the scan reads its pages into
 } Scan_Helper;
 
+/* A function to have the SCAN_PREFETCH table pages after page read
+ * into the buffer pool in the background while the scan is on page, so
+ * it does not wait for the disk at every page.
+ */
+void scanAhead(Scan_Helper *sp, int page) {
+  Table_Header *th = sp->th_header;
+  int first = sp->prefetchedTo + 1;
+  int last = page + SCAN_PREFETCH;
+
+  if (first <= page) first = page + 1;
+  if (last > th->numPages - 1) last = th->numPages - 1;
+  if (first > last) return;
+
+  prefetchPages(buffer_manager, th->pagesList + first, last - first + 1);
+  sp->prefetchedTo = last;
+}
+
 // scans
 RC startScan (RM_TableData *rel, RM_ScanHandle *scan, Expr *cond) {
   scan->rel = rel;
 
-  Scan_Helper *sp = malloc(sizeof(Scan_Helper *));
+  Scan_Helper *sp = malloc(sizeof(Scan_Helper));
   sp->nextRecord = 0;
+  sp->prefetchedTo = -1;
   sp->cond = cond; // ?? or make a copy of cond ??
 
   char *tableName = rel->name; //name of the table
@@ -1229,7 +1385,7 @@ RC startScan (RM_TableData *rel, RM_ScanHandle *scan, Expr *cond) {
     return RC_TABLE_NOT_FOUND;
   }
 
-  int table_page_num = db_header->tableHeaders[table_pos_in_array];
+  PageNumber table_page_num = db_header->tableHeaders[table_pos_in_array];
   
   BM_PageHandle *page_handler_table = MAKE_PAGE_HANDLE(); //page handler for the table header
   page_handler_table->data = "";
@@ -1237,6 +1393,7 @@ RC startScan (RM_TableData *rel, RM_ScanHandle *scan, Expr *cond) {
   Table_Header *th_header = read_table_serializer(page_handler_table->data,db_header); //Table_Header strudture for the data in table header
 
   sp->th_header = th_header;
+  sp->ring = createScanRing(buffer_manager->numPages / 4 < SCAN_RING ? buffer_manager->numPages / 4 : SCAN_RING);
   
   scan->mgmtData = sp;
 
@@ -1263,8 +1420,9 @@ RC next (RM_ScanHandle *scan, Record *record) {
   {
     MAKE_VALUE(result, DT_BOOL, true);
   }
+  scanAhead(sp, id->page);
   
-  while((returnCode = getRecord(scan->rel, *id, record)) != RC_RECORD_OUT_OF_RANGE)
+  while((returnCode = readRecord(scan->rel, *id, record, sp->ring)) != RC_RECORD_OUT_OF_RANGE)
   {
     // printf("record_mgr.next: .......... inside while\n");
     if(returnCode == RC_RECORD_NOT_ACTIVE)
@@ -1274,6 +1432,7 @@ RC next (RM_ScanHandle *scan, Record *record) {
       //update id value, and search again
       id->page = (int)(sp->nextRecord / sp->th_header->slots_per_page);
       id->slot = sp->nextRecord % sp->th_header->slots_per_page;
+      scanAhead(sp, id->page);
       continue;
     } 
     
@@ -1290,6 +1449,7 @@ RC next (RM_ScanHandle *scan, Record *record) {
       //update id value, and search again
       id->page = (int)(sp->nextRecord / sp->th_header->slots_per_page);
       id->slot = sp->nextRecord % sp->th_header->slots_per_page;
+      scanAhead(sp, id->page);
     }
   }
   
@@ -1302,6 +1462,7 @@ RC closeScan (RM_ScanHandle *scan) {
   Scan_Helper *sp = (Scan_Helper *)(scan->mgmtData);
   //free(sp->nextRecord);
   free_table_header(sp->th_header);
+  freeScanRing(sp->ring);
   free(sp);
   return RC_OK;
 }
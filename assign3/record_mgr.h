@@ -1,6 +1,7 @@
 #ifndef RECORD_MGR_H
 #define RECORD_MGR_H
 
+#include "buffer_mgr.h"
 #include "dberror.h"
 #include "expr.h"
 #include "tables.h"
@@ -12,6 +13,23 @@ typedef struct RM_ScanHandle
   void *mgmtData;
 } RM_ScanHandle;
 
+// page usage of the database file, see reportFragmentation
+typedef struct RM_SpaceInfo
+{
+  PageNumber totalPages; // pages handed out so far, including the DB header page
+  PageNumber usedPages;  // pages owned by the DB header and the tables
+  PageNumber freePages;  // pages on the free page list, reused before the file grows
+} RM_SpaceInfo;
+
+// options for initRecordManager, pass NULL for the defaults
+typedef struct RM_Config
+{
+  char *pageFile; // database file, "testrecord.bin" if NULL
+  int pageSize;   // page size for a newly created database file, PAGE_SIZE if 0
+  int numFrames;  // buffer pool frames, 200 with RS_LRU if 0
+  ReplacementStrategy strategy; // buffer pool strategy, only read if numFrames is set
+} RM_Config;
+
 // table and manager
 extern RC initRecordManager (void *mgmtData);
 extern RC shutdownRecordManager ();
@@ -20,6 +38,7 @@ extern RC openTable (RM_TableData *rel, char *name);
 extern RC closeTable (RM_TableData *rel);
 extern RC deleteTable (char *name);
 extern int getNumTuples (RM_TableData *rel);
+extern RC reportFragmentation (RM_SpaceInfo *info);
 
 // handling records in a table
 extern RC insertRecord (RM_TableData *rel, Record *record);
@@ -1,90 +1,500 @@
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define SM_HAVE_IO_URING
+#endif
 
 #include "storage_mgr.h"
 #include "stdlib.h"
 #include "unistd.h"
 #include "string.h"
 
-// #define HEADER_SIZE 6
+/* Bookkeeping kept in SM_FileHandle.mgmtInfo between openPageFile and closePageFile.
+ */
+typedef struct SM_FileInfo {
+  int fd;           // descriptor of the page file (segment 0), open for the handle's lifetime
+  PageNumber headerPages;  // page count currently persisted in the header page
+  PageNumber pendingAppends; // appends since the header was last written
+  PageNumber allocatedPages; // data pages physically present in the file (>= totalNumPages)
+  int pageSize;     // bytes per page, from the superblock
+  PageNumber segmentPages; // pages per segment file, header page included; 0 if not segmented
+  int *segFds;      // descriptor of every segment file, segFds[0] == fd
+  int numSegments;
+  int openFlags;    // flags segment files are opened with
+  pthread_mutex_t segLock; // guards segFds/numSegments growth, openFlags and the O_DIRECT drop
+  char *fileName;   // name of segment 0, segment k is fileName.k
+  SM_StorageMode mode; // how block reads/writes reach the file; DIRECT may drop to PREAD at any time
+  bool readOnly;    // descriptor (and mapping) only allow reads
+  char *map;        // SM_MODE_MMAP: the file mapped from offset 0, else NULL
+  size_t mapSize;   // bytes mapped, the header page plus allocatedPages pages
+  struct SM_AsyncQueue *aio; // queue set up by initAsyncIO, or NULL
+} SM_FileInfo;
+
+/* Number of appends after which the header page is rewritten even if the file
+ * is neither synced nor closed. See setHeaderSyncInterval().
+ */
+static int headerSyncInterval = 64;
+
+/* Mode used by handles opened from now on. See setStorageMode(). */
+static SM_StorageMode storageMode = SM_MODE_PREAD;
+
+/* Segment size of page files created from now on. See setSegmentSize(). */
+static PageNumber segmentSize = 0;
+
+/* How the physical file grows when pages are added. See setExtentGrowth(). */
+static SM_GrowthPolicy growthPolicy = SM_GROW_EXACT;
+static int growthIncrement = 1;
+
+/* Byte offset of a data page in a single-file page file. Page 0 of the file is
+ * the header page, so data page pageNum lives at (pageNum + 1) * pageSize.
+ */
+#define PAGE_OFFSET(fi, pageNum) ((off_t)((pageNum) + 1) * (fi)->pageSize)
+
+/* Superblock identification: "DBPF" and the current format version. Files
+ * without the magic number predate the superblock and are version 0 with
+ * PAGE_SIZE pages.
+ */
+#define SM_MAGIC 0x46504244
+#define SM_FORMAT_VERSION 1
 
-static int HEADER_SIZE = 6;
+/* Contents of the header page. The fields sit in the first SM_MIN_PAGE_SIZE
+ * bytes, so the header can be read before the page size is known.
+ */
+typedef struct SM_Superblock {
+  PageNumber totalNumPages;  // offset 0
+  PageNumber segmentPages;   // offset 8, 0 if not segmented
+  int magic;                 // offset 16
+  int version;               // offset 20
+  int pageSize;              // offset 24
+} SM_Superblock;
+
+/* Buffer and offset alignment required by SM_MODE_DIRECT (O_DIRECT) transfers. */
+#define SM_IO_ALIGN 4096
+#define IS_IO_ALIGNED(p) (((uintptr_t)(p) % SM_IO_ALIGN) == 0)
+
+#ifndef O_DIRECT
+#define O_DIRECT 0
+#endif
+
+// most vectors a single preadv/pwritev accepts
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
 
 /************************************************************
  *                    Functions definitions                 *
  ************************************************************/
 
-/* Read the header page and place the file pointer to the next page, where the actual data starts. 
- * Return the value in header as an integer, which is the number of pages in the file.
+/* Read exactly size bytes at offset, retrying on short reads and EINTR.
+ * Return RC_OK, or RC_FILE_R_W_ERROR if the range could not be read.
  */
-int
-readHeader (FILE *fp)
+static RC
+preadFull (int fd, char *buff, size_t size, off_t offset)
 {
-  int head_size = 0;
-  char *buff;
-  // char *header_str;
-	
-  // buff = (char *)malloc(sizeof(char) * PAGE_SIZE);
-	// header_str = (char *)malloc(16);
+  ssize_t n;
+
+  while (size > 0) {
+    n = pread(fd, buff, size, offset);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return RC_FILE_R_W_ERROR;
+    buff += n;
+    offset += n;
+    size -= n;
+  }
+  return RC_OK;
+}
 
-  buff = malloc(sizeof(*buff) * PAGE_SIZE);
+/* Write exactly size bytes at offset, retrying on short writes and EINTR.
+ * Return RC_OK, or RC_WRITE_FAILED if the range could not be written.
+ */
+static RC
+pwriteFull (int fd, const char *buff, size_t size, off_t offset)
+{
+  ssize_t n;
+
+  while (size > 0) {
+    n = pwrite(fd, buff, size, offset);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return RC_WRITE_FAILED;
+    buff += n;
+    offset += n;
+    size -= n;
+  }
+  return RC_OK;
+}
 
+/* Transfer the pages described by iov (cnt entries of one page each) to or from
+ * consecutive file offsets starting at offset, with as few preadv/pwritev calls as
+ * IOV_MAX allows. Short transfers and EINTR are retried from where they stopped.
+ */
+static RC
+pvFull (int fd, struct iovec *iov, int cnt, off_t offset, bool write)
+{
+  ssize_t n;
+  int batch;
+
+  while (cnt > 0) {
+    batch = cnt > IOV_MAX ? IOV_MAX : cnt;
+    n = write ? pwritev(fd, iov, batch, offset) : preadv(fd, iov, batch, offset);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return write ? RC_WRITE_FAILED : RC_FILE_R_W_ERROR;
+
+    offset += n;
+    // skip the iovecs fully transferred, trim a partially transferred one
+    while (cnt > 0 && (size_t)n >= iov->iov_len) {
+      n -= iov->iov_len;
+      iov++;
+      cnt--;
+    }
+    if (n > 0) {
+      iov->iov_base = (char *)iov->iov_base + n;
+      iov->iov_len -= n;
+    }
+  }
+  return RC_OK;
+}
 
-  // fread(header_str, sizeof(char)*HEADER_SIZE, 1, fp);
-	// fread(buff, sizeof(char)*HEADER_SIZE, 1, fp);
- //  head_size = atoi(buff);
-	// fread(buff, sizeof(char)*(PAGE_SIZE - HEADER_SIZE), 1, fp);
+/* Return the bookkeeping of an open handle, or NULL if the handle is not open. */
+static SM_FileInfo *
+handleInfo (SM_FileHandle *fHandle)
+{
+  if (fHandle == NULL) return NULL;
+  return (SM_FileInfo *)fHandle->mgmtInfo;
+}
 
-  fread(buff, sizeof(*buff) * PAGE_SIZE, 1, fp);
-  memcpy(&head_size, buff, sizeof(head_size));
+/* Find where data page pageNum lives: return the descriptor of the segment
+ * file holding it and set *offset to the page's offset in that segment. The
+ * header page fills the first slot of segment 0, so page pageNum is slot
+ * pageNum + 1. If runPages is given it is set to the number of pages from
+ * pageNum to the end of the segment.
+ */
+static int
+pageLocation (SM_FileInfo *fi, PageNumber pageNum, off_t *offset, PageNumber *runPages)
+{
+  PageNumber slot = pageNum + 1;
 
-	free(buff);
+  if (fi->segmentPages == 0) {
+    *offset = PAGE_OFFSET(fi, pageNum);
+    if (runPages != NULL) *runPages = LLONG_MAX;
+    return fi->fd;
+  }
 
+  *offset = (off_t)(slot % fi->segmentPages) * fi->pageSize;
+  if (runPages != NULL) *runPages = fi->segmentPages - slot % fi->segmentPages;
+  return fi->segFds[slot / fi->segmentPages];
+}
 
-  // free(header_str);
+/* Name of segment seg of fileName: the file itself for segment 0, fileName.seg
+ * otherwise. The result has to be freed.
+ */
+static char *
+segmentName (const char *fileName, int seg)
+{
+  size_t len = strlen(fileName) + 16;
+  char *name = (char *)malloc(len);
 
-	return head_size;
+  if (seg == 0) snprintf(name, len, "%s", fileName);
+  else snprintf(name, len, "%s.%d", fileName, seg);
+  return name;
 }
 
-/* Write the value of totalNumPages to the header page, appending '\0' after it in header page.
- * If there's error during writing header or '\0', return RC_FILE_R_W_ERROR.
+/* Open the next segment file of the handle, creating it if create is set.
+ * Return RC_FILE_NOT_FOUND if it doesn't exist and create is not set.
  */
-int
-writeHeader (FILE *fp, int totalNumPages)
+static RC
+openNextSegment (SM_FileInfo *fi, bool create)
+{
+  char *name;
+  int fd;
+
+  pthread_mutex_lock(&fi->segLock);
+  name = segmentName(fi->fileName, fi->numSegments);
+  fd = open(name, (fi->readOnly ? O_RDONLY : O_RDWR) | fi->openFlags | (create ? O_CREAT : 0), 0644);
+  free(name);
+  if (fd < 0) {
+    pthread_mutex_unlock(&fi->segLock);
+    return (errno == ENOENT) ? RC_FILE_NOT_FOUND : RC_FILE_R_W_ERROR;
+  }
+
+  fi->segFds = (int *)realloc(fi->segFds, sizeof(int) * (fi->numSegments + 1));
+  fi->segFds[fi->numSegments++] = fd;
+  pthread_mutex_unlock(&fi->segLock);
+  return RC_OK;
+}
+
+/* (Re)map the whole file after it was opened or grew. If the mapping can't be
+ * made the handle quietly falls back to positional I/O.
+ */
+static void
+remapFile (SM_FileInfo *fi)
 {
-	int size_header;
-	char *header;
-	char zero = '\0';
+  size_t size = PAGE_OFFSET(fi, fi->allocatedPages);
+  char *map;
+
+  if (fi->map != NULL) {
+    munmap(fi->map, fi->mapSize);
+    fi->map = NULL;
+  }
+
+  map = mmap(NULL, size, fi->readOnly ? PROT_READ : (PROT_READ | PROT_WRITE), MAP_SHARED, fi->fd, 0);
+  if (map == MAP_FAILED) {
+    fi->mode = SM_MODE_PREAD;
+    return;
+  }
+  fi->map = map;
+  fi->mapSize = size;
+}
 
-	// header = (char*)malloc(sizeof(char)*HEADER_SIZE);
+/* A transfer made while *direct was set failed: if the file system refused
+ * O_DIRECT, turn the handle into a plain buffered one and return true so the
+ * caller retries once. Concurrent transfers may fail together; segLock lets
+ * only the first one switch the descriptors, the others just retry.
+ */
+static bool
+dropDirectIO (SM_FileInfo *fi, bool *direct)
+{
+  int flags, i;
+  bool retry = true;
+
+  if (!*direct || errno != EINVAL) return false;
+  *direct = false;
+
+  pthread_mutex_lock(&fi->segLock);
+  if (__atomic_load_n(&fi->mode, __ATOMIC_ACQUIRE) == SM_MODE_DIRECT) {
+    for (i = 0; i < fi->numSegments && retry; i++) {
+      if ((flags = fcntl(fi->segFds[i], F_GETFL)) < 0
+          || fcntl(fi->segFds[i], F_SETFL, flags & ~O_DIRECT) < 0)
+        retry = false;
+    }
+    if (retry) {
+      fi->openFlags &= ~O_DIRECT;
+      __atomic_store_n(&fi->mode, SM_MODE_PREAD, __ATOMIC_RELEASE);
+    }
+  }
+  pthread_mutex_unlock(&fi->segLock);
+  return retry;
+}
 
- //  sprintf(header, "%06d", totalNumPages);
+/* Move one page between buff and page pageNum. On a mapped file this is a
+ * memcpy; in direct mode an unaligned buff goes through an aligned page
+ * allocated for the call.
+ */
+static RC
+transferPage (SM_FileInfo *fi, char *buff, PageNumber pageNum, bool write)
+{
+  char *io = buff;
+  off_t offset;
+  int fd;
+  bool direct;
+  RC rc_code;
 
-  header = malloc(sizeof(*header) * PAGE_SIZE);
-  memset(header, 0, sizeof(*header) * PAGE_SIZE);
+  if (write && fi->readOnly) return RC_WRITE_FAILED;
 
-  memcpy(header, &totalNumPages, sizeof(totalNumPages));
+  if (fi->map != NULL) {
+    if (write) memcpy(fi->map + PAGE_OFFSET(fi, pageNum), buff, fi->pageSize);
+    else memcpy(buff, fi->map + PAGE_OFFSET(fi, pageNum), fi->pageSize);
+    return RC_OK;
+  }
 
-	// printf("%06d\n", totalNumPages);
+  direct = (__atomic_load_n(&fi->mode, __ATOMIC_ACQUIRE) == SM_MODE_DIRECT);
+  if (direct && !IS_IO_ALIGNED(buff)) {
+    if (posix_memalign((void **)&io, SM_IO_ALIGN, fi->pageSize) != 0) return RC_MEM_ALLOC_FAILED;
+    if (write) memcpy(io, buff, fi->pageSize);
+  }
 
-	fseek(fp, 0L, SEEK_SET);
-	// if ((size_header = fwrite(header, sizeof(char)*HEADER_SIZE, 1, fp)) < 1) {
-	// 	// printf("\nWRITEHEADER(header): size_header %d\n", size_header);
-	// 	return RC_FILE_R_W_ERROR;
-	// }
-	// if ((size_header = fwrite(&zero, sizeof(char), PAGE_SIZE - HEADER_SIZE, fp)) < 1) {
-	// 	// printf("\nWRITEHEADER(zeros): size_header %d\n", size_header);
-	// 	return RC_FILE_R_W_ERROR;
-	// }
+  fd = pageLocation(fi, pageNum, &offset, NULL);
+  do {
+    rc_code = write ? pwriteFull(fd, io, fi->pageSize, offset)
+                    : preadFull(fd, io, fi->pageSize, offset);
+  } while (rc_code != RC_OK && dropDirectIO(fi, &direct));
 
-  if ((size_header = fwrite(header, sizeof(*header) * PAGE_SIZE, 1, fp)) < 1) {
-    return RC_FILE_R_W_ERROR;
+  if (io != buff) {
+    if (rc_code == RC_OK && !write) memcpy(buff, io, fi->pageSize);
+    free(io);
+  }
+  return rc_code;
+}
+
+/* Move cnt pages between the iov buffers and consecutive pages starting at
+ * pageNum, by memcpy on a mapped file or by vectored positional I/O otherwise
+ * (one call per segment file the run touches).
+ */
+static RC
+transferRun (SM_FileInfo *fi, struct iovec *iov, int cnt, PageNumber pageNum, bool write)
+{
+  char *page;
+  PageNumber segRun;
+  off_t offset;
+  int i, fd, n;
+  bool direct;
+  RC rc_code;
+
+  if (write && fi->readOnly) return RC_WRITE_FAILED;
+
+  if (fi->map == NULL) {
+    // O_DIRECT needs every buffer aligned; otherwise go page by page
+    direct = (__atomic_load_n(&fi->mode, __ATOMIC_ACQUIRE) == SM_MODE_DIRECT);
+    for (i = 0; direct && i < cnt; i++) {
+      if (!IS_IO_ALIGNED(iov[i].iov_base)) break;
+    }
+    if (direct && i < cnt) {
+      for (i = 0, rc_code = RC_OK; i < cnt && rc_code == RC_OK; i++)
+        rc_code = transferPage(fi, iov[i].iov_base, pageNum + i, write);
+      return rc_code;
+    }
+
+    while (cnt > 0) {
+      fd = pageLocation(fi, pageNum, &offset, &segRun);
+      n = (segRun < cnt) ? (int)segRun : cnt;
+      while ((rc_code = pvFull(fd, iov, n, offset, write)) != RC_OK && dropDirectIO(fi, &direct));
+      if (rc_code != RC_OK) return rc_code;
+      iov += n;
+      cnt -= n;
+      pageNum += n;
+    }
+    return RC_OK;
+  }
+
+  page = fi->map + PAGE_OFFSET(fi, pageNum);
+  for (i = 0; i < cnt; i++, page += fi->pageSize) {
+    if (write) memcpy(page, iov[i].iov_base, fi->pageSize);
+    else memcpy(iov[i].iov_base, page, fi->pageSize);
   }
+  return RC_OK;
+}
+
+/* Read the superblock from the header page at offset 0. A header without the
+ * magic number is from before the superblock: it only holds the page count
+ * (written as a 4-byte int, padded with '\0') and the segment size, and the
+ * file uses PAGE_SIZE pages. Return RC_OK, RC_UNSUPPORTED_FORMAT for a file
+ * that is neither (its padding is not '\0') or was written by a newer
+ * format version, or RC_FILE_R_W_ERROR if the header could not be read or
+ * describes no valid page file.
+ */
+static RC
+readHeader (int fd, SM_Superblock *sb)
+{
+  char *buff = allocPageBuffer(1);
+  RC rc_code;
+
+  if (buff == NULL) return RC_FILE_R_W_ERROR;
+  rc_code = preadFull(fd, buff, SM_MIN_PAGE_SIZE, 0);
+  memcpy(sb, buff, sizeof(SM_Superblock));
+  freePageBuffer(buff);
+  if (rc_code != RC_OK) return RC_FILE_R_W_ERROR;
+
+  if (sb->magic != SM_MAGIC) {
+    if (sb->magic != 0 || sb->version != 0 || sb->pageSize != 0) return RC_UNSUPPORTED_FORMAT;
+    sb->magic = SM_MAGIC;
+    sb->version = 0;
+    sb->pageSize = PAGE_SIZE;
+  }
+  if (sb->version > SM_FORMAT_VERSION) return RC_UNSUPPORTED_FORMAT;
+  if (sb->totalNumPages < 1 || sb->pageSize < SM_MIN_PAGE_SIZE || sb->pageSize > SM_MAX_PAGE_SIZE)
+    return RC_FILE_R_W_ERROR;
+  return RC_OK;
+}
+
+/* Write the superblock to the header page, padding the rest of its first
+ * SM_MIN_PAGE_SIZE bytes with '\0'. Return 1 on success, RC_FILE_R_W_ERROR otherwise.
+ */
+static int
+writeHeader (int fd, SM_Superblock *sb)
+{
+  char *header = allocPageBuffer(1);
+  int rc = 1;
 
+  if (header == NULL) return RC_FILE_R_W_ERROR;
+  sb->magic = SM_MAGIC;
+  sb->version = SM_FORMAT_VERSION;
+  memcpy(header, sb, sizeof(SM_Superblock));
 
-	free(header);
-	// printf("\nWRITEHEADER(return): size_header %d\n", size_header);
+  if (pwriteFull(fd, header, SM_MIN_PAGE_SIZE, 0) != RC_OK) rc = RC_FILE_R_W_ERROR;
 
-	return size_header;
+  freePageBuffer(header);
+  return rc;
+}
+
+/* Persist the in-handle page count to the header page if it changed since the
+ * last time it was written.
+ */
+static RC
+flushHeader (SM_FileHandle *fHandle)
+{
+  SM_FileInfo *fi = (SM_FileInfo *)fHandle->mgmtInfo;
+  SM_Superblock sb;
+
+  if (fi->headerPages != fHandle->totalNumPages) {
+    sb.totalNumPages = fHandle->totalNumPages;
+    sb.segmentPages = fi->segmentPages;
+    sb.pageSize = fi->pageSize;
+    if (writeHeader(fi->fd, &sb) < 1) return RC_FILE_R_W_ERROR;
+    fi->headerPages = fHandle->totalNumPages;
+  }
+  fi->pendingAppends = 0;
+  return RC_OK;
+}
+
+/* Make sure at least numberOfPages data pages physically exist in the file,
+ * growing it in a single call. Depending on the growth policy more pages than
+ * requested may be allocated; they read back as zeros and only become visible
+ * through totalNumPages when appended.
+ */
+static RC
+allocateExtent (SM_FileHandle *fHandle, PageNumber numberOfPages)
+{
+  SM_FileInfo *fi = (SM_FileInfo *)fHandle->mgmtInfo;
+  PageNumber target = numberOfPages;
+  PageNumber from, count;
+  off_t offset;
+  int fd;
+
+  if (numberOfPages <= fi->allocatedPages) return RC_OK;
+
+  switch (growthPolicy)
+  {
+  case SM_GROW_FIXED:
+    target = fi->allocatedPages + growthIncrement;
+    break;
+  case SM_GROW_DOUBLE:
+    target = fi->allocatedPages * 2;
+    if (target - fi->allocatedPages < growthIncrement) target = fi->allocatedPages + growthIncrement;
+    break;
+  default:
+    break;
+  }
+  if (target < numberOfPages) target = numberOfPages;
+
+  // grow segment by segment, creating segment files as they are reached
+  for (from = fi->allocatedPages; from < target; from += count) {
+    if (fi->segmentPages > 0 && (from + 1) / fi->segmentPages >= fi->numSegments
+        && openNextSegment(fi, true) != RC_OK)
+      return RC_WRITE_FAILED;
+    fd = pageLocation(fi, from, &offset, &count);
+    if (count > target - from) count = target - from;
+
+    // posix_fallocate reserves the blocks; fall back to a sparse ftruncate on
+    // file systems that can't preallocate
+    if (posix_fallocate(fd, offset, (off_t)count * fi->pageSize) != 0
+        && ftruncate(fd, offset + (off_t)count * fi->pageSize) < 0)
+      return RC_WRITE_FAILED;
+    fi->allocatedPages = from + count;
+  }
+
+  if (fi->mode == SM_MODE_MMAP) remapFile(fi);
+  return RC_OK;
 }
 
 void
@@ -93,84 +503,326 @@ initStorageManager (void)
 
 }
 
-/* Create a new page file with fileName. The initial file size is one page,
- * fill this single page with '\0' bytes. 
- * Write the initial number of pages to the header, which is 1.
- * If there's error during writing header or '\0', return RC_FILE_R_W_ERROR.
+/* Choose how handles opened from now on reach the file: SM_MODE_PREAD issues a
+ * positional read/write call per transfer, SM_MODE_MMAP maps the file and turns
+ * block reads/writes into memcpys (remapping when the file grows), and
+ * SM_MODE_DIRECT opens the file with O_DIRECT so reads and writes bypass the OS
+ * page cache. Direct mode falls back to SM_MODE_PREAD on file systems that
+ * reject O_DIRECT; buffers from allocPageBuffer() avoid a bounce copy.
+ */
+void
+setStorageMode (SM_StorageMode mode)
+{
+  storageMode = mode;
+}
+
+/* Split page files created from now on into segment files of pagesPerSegment
+ * pages each (the header page counts towards the first one): fileName holds
+ * segment 0 and fileName.1, fileName.2, ... the following ones, created as the
+ * file grows. Segments keep every single file small while the page file as a
+ * whole can reach any size, and transfers on different segments go to
+ * different descriptors. 0 (the default) keeps the whole page file in one
+ * file. The segment size is recorded in the header, so existing files keep
+ * the layout they were created with. Segmented files don't support
+ * SM_MODE_MMAP and use positional I/O instead.
+ */
+void
+setSegmentSize (PageNumber pagesPerSegment)
+{
+  // segment 0 holds at least the header page and page 0
+  if (pagesPerSegment <= 0) segmentSize = 0;
+  else segmentSize = pagesPerSegment < 2 ? 2 : pagesPerSegment;
+}
+
+/* Choose how the file grows when appendEmptyBlock/ensureCapacity need more space:
+ * SM_GROW_EXACT allocates exactly the pages requested, SM_GROW_FIXED allocates
+ * extents of increment pages, and SM_GROW_DOUBLE doubles the allocation (by at
+ * least increment pages). Space allocated ahead of totalNumPages is trimmed
+ * when the file is closed.
+ */
+void
+setExtentGrowth (SM_GrowthPolicy policy, int increment)
+{
+  growthPolicy = policy;
+  growthIncrement = increment < 1 ? 1 : increment;
+}
+
+/* Set how many appends may accumulate before the header page is rewritten.
+ * Until then fHandle->totalNumPages is the authoritative page count; the header
+ * is always written on syncPageFile and closePageFile. Values below 1 mean
+ * every append writes the header.
+ */
+void
+setHeaderSyncInterval (int numberOfAppends)
+{
+  headerSyncInterval = numberOfAppends < 1 ? 1 : numberOfAppends;
+}
+
+/* Allocate size zeroed bytes aligned for SM_MODE_DIRECT transfers. */
+static SM_PageHandle
+allocAligned (size_t size)
+{
+  void *buff;
+
+  if (posix_memalign(&buff, SM_IO_ALIGN, size) != 0) return NULL;
+  memset(buff, 0, size);
+  return (SM_PageHandle)buff;
+}
+
+/* Allocate numPages zeroed pages of PAGE_SIZE bytes aligned for SM_MODE_DIRECT
+ * transfers. Release them with freePageBuffer(). Return NULL if out of memory.
+ */
+SM_PageHandle
+allocPageBuffer (int numPages)
+{
+  return allocAligned((size_t)numPages * PAGE_SIZE);
+}
+
+/* Like allocPageBuffer(), but with pages the size of the open file's pages. */
+SM_PageHandle
+allocFileBuffer (SM_FileHandle *fHandle, int numPages)
+{
+  return allocAligned((size_t)numPages * fHandle->pageSize);
+}
+
+void
+freePageBuffer (SM_PageHandle buff)
+{
+  free(buff);
+}
+
+/* Create a new page file with fileName and PAGE_SIZE pages.
  */
 RC
 createPageFile (char *fileName)
 {
-	FILE *fp;
-	size_t size_wrote;
-	int size_header;
-  // char zero = '\0';
-	char *zero = (char *)malloc(sizeof(char) * PAGE_SIZE);
-  strncpy(zero, "\0", sizeof(char) * PAGE_SIZE);
-
-	if ((fp = fopen(fileName, "w")) == NULL) return RC_FILE_R_W_ERROR;
-	
-	// First we write the initial file handler information (1 page count)
-	if ((size_header = writeHeader(fp, 1)) < 1) {
-		// printf("CREATEPAGEFILE(writeHeader): size_header %d\n", size_header);
-		return RC_FILE_R_W_ERROR;
-	}
+  return createPageFileWithSize(fileName, PAGE_SIZE);
+}
+
+/* Create a new page file with fileName whose pages are pageSize bytes, a power
+ * of two between SM_MIN_PAGE_SIZE and SM_MAX_PAGE_SIZE (else return
+ * RC_INVALID_PAGE_SIZE). The initial file size is one page, filled with '\0'
+ * bytes. The superblock records the page size, the format version and the
+ * initial number of pages, which is 1.
+ * If there's error during writing header or '\0', return RC_FILE_R_W_ERROR.
+ */
+RC
+createPageFileWithSize (char *fileName, int pageSize)
+{
+  int fd;
+  SM_Superblock sb;
 
-	// We fill in with '\0' a single page
-	size_wrote = fwrite(zero, sizeof(char)*PAGE_SIZE, 1, fp);
-	// printf("CREATEPAGEFILE(fwrite): size_wrote %d\n", size_wrote);
+  if (pageSize < SM_MIN_PAGE_SIZE || pageSize > SM_MAX_PAGE_SIZE || (pageSize & (pageSize - 1)) != 0)
+    return RC_INVALID_PAGE_SIZE;
 
-  free(zero);
+  if ((fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) return RC_FILE_R_W_ERROR;
 
-	if (size_wrote != 1) {
-		return RC_FILE_R_W_ERROR;
-	} else {
-		fclose(fp);
-		return RC_OK;
-	}
-	
+  // the header page and the single data page, both '\0'
+  if (ftruncate(fd, (off_t)2 * pageSize) < 0) {
+    close(fd);
+    return RC_FILE_R_W_ERROR;
+  }
+
+  // First we write the initial file handler information (1 page count)
+  sb.totalNumPages = 1;
+  sb.segmentPages = segmentSize;
+  sb.pageSize = pageSize;
+  if (writeHeader(fd, &sb) < 1) {
+    close(fd);
+    return RC_FILE_R_W_ERROR;
+  }
+
+  if (close(fd) < 0) return RC_FILE_R_W_ERROR;
+  return RC_OK;
 }
 
-/* Opens an existing page file, if it does not exist, return RC_FILE_NOT_FOUND.
- * Then read header first, and the fields of this file handle are initialized 
- * with the information about the opened file.
+/* Opens an existing page file, if it does not exist, return RC_FILE_NOT_FOUND,
+ * and RC_UNSUPPORTED_FORMAT if it is not a page file this code can read.
+ * The descriptor stays open in fHandle->mgmtInfo until closePageFile, so block
+ * accesses don't have to reopen the file. Then read header first, and the fields
+ * of this file handle are initialized with the information about the opened file.
  */
 RC
 openPageFile (char *fileName, SM_FileHandle *fHandle)
 {
-	FILE *fp;
-	int totalNumPages;
-	
-	if (access(fileName, R_OK) < 0) return RC_FILE_NOT_FOUND;
-	
-	fp = fopen(fileName, "r");
+  int fd, flags = 0;
+  PageNumber totalNumPages, filePages, segmentPages;
+  SM_Superblock sb;
+  off_t fileSize;
+  bool readOnly = false;
+  SM_StorageMode mode = storageMode;
+  SM_FileInfo *fi;
+  struct stat fileStat;
+  RC rc_code;
+
+  if (mode == SM_MODE_DIRECT) flags = O_DIRECT;
+
+  fd = open(fileName, O_RDWR | flags);
+  if (fd < 0 && errno == EINVAL && flags != 0) {
+    // file system without O_DIRECT support
+    mode = SM_MODE_PREAD;
+    flags = 0;
+    fd = open(fileName, O_RDWR);
+  }
+  if (fd < 0 && (errno == EACCES || errno == EROFS)) {
+    fd = open(fileName, O_RDONLY | flags);
+    readOnly = true;
+  }
+  if (fd < 0) return (errno == ENOENT) ? RC_FILE_NOT_FOUND : RC_FILE_R_W_ERROR;
+
+  if ((rc_code = readHeader(fd, &sb)) != RC_OK || fstat(fd, &fileStat) < 0) {
+    close(fd);
+    return rc_code == RC_UNSUPPORTED_FORMAT ? rc_code : RC_FILE_R_W_ERROR;
+  }
+  totalNumPages = sb.totalNumPages;
+  segmentPages = sb.segmentPages;
+
+  fi = (SM_FileInfo *)malloc(sizeof(SM_FileInfo));
+  fi->fd = fd;
+  fi->headerPages = totalNumPages;
+  fi->pendingAppends = 0;
+  fi->pageSize = sb.pageSize;
+  fi->segmentPages = segmentPages;
+  fi->segFds = (int *)malloc(sizeof(int));
+  fi->segFds[0] = fd;
+  fi->numSegments = 1;
+  fi->openFlags = flags;
+  pthread_mutex_init(&fi->segLock, NULL);
+  fi->fileName = segmentName(fileName, 0);
+  fi->readOnly = readOnly;
+
+  // every segment but the last one is full
+  fileSize = fileStat.st_size;
+  while (segmentPages > 0 && openNextSegment(fi, false) == RC_OK) {
+    if (fstat(fi->segFds[fi->numSegments - 1], &fileStat) < 0) fileStat.st_size = 0;
+    fileSize = (off_t)(fi->numSegments - 1) * segmentPages * fi->pageSize + fileStat.st_size;
+  }
+  if (segmentPages > 0 && mode == SM_MODE_MMAP) mode = SM_MODE_PREAD;
+
+  // A superblock's page count is authoritative: pages past it are either an
+  // extent preallocated by a handle that was never closed or appends the lazy
+  // header never recorded, and both are remembered as allocated-but-unused so
+  // the next close trims them. Legacy headers carry no such guarantee, so
+  // there the file size wins when it is larger.
+  filePages = (PageNumber)(fileSize / fi->pageSize) - 1;
+  if (sb.version == 0 && filePages > totalNumPages) totalNumPages = filePages;
+  fi->allocatedPages = filePages > totalNumPages ? filePages : totalNumPages;
+  fi->mode = mode;
+  fi->map = NULL;
+  fi->mapSize = 0;
+  fi->aio = NULL;
+  if (fi->mode == SM_MODE_MMAP) remapFile(fi);
+
+  fHandle->fileName = fileName;
+  fHandle->totalNumPages = totalNumPages;
+  fHandle->curPagePos = 0;
+  fHandle->pageSize = fi->pageSize;
+  fHandle->mgmtInfo = fi;
+
+  return RC_OK;
+}
 
-	if ((totalNumPages = readHeader(fp)) < 1) return RC_FILE_R_W_ERROR;
+/* Cut the file back to numPages data pages, removing segment files that are
+ * no longer needed.
+ */
+static RC
+trimFile (SM_FileInfo *fi, PageNumber numPages)
+{
+  PageNumber slots = numPages + 1; // header page included
+  char *name;
+  int keep = 1;
 
-	fHandle->fileName = fileName;
-	fHandle->totalNumPages = totalNumPages;
-	fHandle->curPagePos = 0;
+  if (fi->segmentPages == 0) {
+    return ftruncate(fi->fd, PAGE_OFFSET(fi, numPages)) < 0 ? RC_FILE_R_W_ERROR : RC_OK;
+  }
 
-	fclose(fp);
+  keep = (int)((slots + fi->segmentPages - 1) / fi->segmentPages);
+  if (ftruncate(fi->segFds[keep - 1], (off_t)(slots - (PageNumber)(keep - 1) * fi->segmentPages) * fi->pageSize) < 0)
+    return RC_FILE_R_W_ERROR;
 
-	return RC_OK;
+  while (fi->numSegments > keep) {
+    fi->numSegments--;
+    close(fi->segFds[fi->numSegments]);
+    name = segmentName(fi->fileName, fi->numSegments);
+    unlink(name);
+    free(name);
+  }
+  return RC_OK;
 }
 
-/* Close page file by changing the curPagePos to 0.
+/* Close page file: finish outstanding asynchronous transfers, persist the
+ * header, give back any preallocated extent, release the descriptor and set
+ * the curPagePos to 0.
  */
 RC
 closePageFile (SM_FileHandle *fHandle)
 {
-	fHandle->curPagePos = 0;
-	return RC_OK;
+  SM_FileInfo *fi = (SM_FileInfo *)fHandle->mgmtInfo;
+  RC rc_code = RC_OK;
+  int i;
+
+  fHandle->curPagePos = 0;
+  if (fi == NULL) return RC_OK;
+
+  if (fi->aio != NULL) shutdownAsyncIO(fHandle);
+  rc_code = flushHeader(fHandle);
+  if (fi->map != NULL) munmap(fi->map, fi->mapSize);
+  if (fi->allocatedPages > fHandle->totalNumPages && trimFile(fi, fHandle->totalNumPages) != RC_OK)
+    rc_code = RC_FILE_R_W_ERROR;
+  for (i = 0; i < fi->numSegments; i++) {
+    if (close(fi->segFds[i]) < 0) rc_code = RC_FILE_R_W_ERROR;
+  }
+  pthread_mutex_destroy(&fi->segLock);
+  free(fi->segFds);
+  free(fi->fileName);
+  free(fi);
+  fHandle->mgmtInfo = NULL;
+
+  return rc_code;
+}
+
+/* Write the page count to the header page and flush the file (and its mapping,
+ * if any) to disc.
+ */
+RC
+syncPageFile (SM_FileHandle *fHandle)
+{
+  RC rc_code;
+  SM_FileInfo *fi;
+  int i;
+
+  if ((fi = handleInfo(fHandle)) == NULL) return RC_FILE_HANDLE_NOT_INIT;
+
+  if ((rc_code = flushHeader(fHandle)) != RC_OK) return rc_code;
+  if (fi->map != NULL && msync(fi->map, fi->mapSize, MS_SYNC) < 0) return RC_FILE_R_W_ERROR;
+  for (i = 0; i < fi->numSegments; i++) {
+    if (fsync(fi->segFds[i]) < 0) return RC_FILE_R_W_ERROR;
+  }
+
+  return RC_OK;
 }
 
-/* Destroy page file by removing the file from disc.
+/* Destroy page file by removing the file (and its segment files) from disc.
  */
 RC
 destroyPageFile (char *fileName)
 {
+	SM_Superblock sb;
+	char *name;
+	int fd, seg;
+
 	if (access(fileName, R_OK) < 0) return RC_FILE_NOT_FOUND;
+	sb.segmentPages = 0;
+	if ((fd = open(fileName, O_RDONLY)) >= 0) {
+		if (readHeader(fd, &sb) != RC_OK) sb.segmentPages = 0;
+		close(fd);
+	}
+	for (seg = 1; sb.segmentPages > 0; seg++) {
+		name = segmentName(fileName, seg);
+		fd = remove(name);
+		free(name);
+		if (fd < 0) break;
+	}
 	if (remove(fileName) < 0) {
 		return RC_FILE_R_W_ERROR;
 	} else {
@@ -178,58 +830,31 @@ destroyPageFile (char *fileName)
 	}
 }
 
-/* Reads the pageNumth block from a file and stores its content in the memory 
+/* Reads the pageNumth block from a file and stores its content in the memory
  * pointed to by the memPage page handle.
- * Check if the pageNum is valid (should be >= 0 and <= totalNumPages)
- * The method reads all pages from the first one to the pageNumth to the buffer
- * then copy the last page from buffer to memPage. Set curPagePos = pageNum.
+ * Check if the pageNum is valid (should be >= 0 and < totalNumPages), then
+ * read the page straight from its offset into memPage. Set curPagePos = pageNum.
  */
 RC
-readBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
+readBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
 {
-	FILE *fp;
-	int totalNumPages;
-	char *buff;
-
-	int rc_access;
-	if ((rc_access = access(fHandle->fileName, R_OK)) < 0) {
-		printf("rc_access: %d\n", rc_access);
-		return RC_FILE_NOT_FOUND;
-	} 
+  SM_FileInfo *fi;
 
-	fp = fopen(fHandle->fileName, "r");
+  if ((fi = handleInfo(fHandle)) == NULL) return RC_FILE_HANDLE_NOT_INIT;
 
-	buff = (char*)malloc(sizeof(char)*PAGE_SIZE);
-  int i;
-  // for (i = 0; i < PAGE_SIZE; i++) {
-  //   memcpy(buff + i, '\0', sizeof(char));
-  // }
-
-	if ( (totalNumPages = readHeader(fp)) < 1) return RC_FILE_R_W_ERROR;
-
-	//check if pageNum is valid
-	if ((pageNum >= totalNumPages) || (pageNum < 0)) return RC_READ_NON_EXISTING_PAGE;
-
-	for (i = 0; i < (pageNum +1); i++) {
-		fread(buff, sizeof(char)*PAGE_SIZE, 1, fp);
-	}
+  //check if pageNum is valid
+  if ((pageNum >= fHandle->totalNumPages) || (pageNum < 0)) return RC_READ_NON_EXISTING_PAGE;
 
-  memcpy(memPage, buff, PAGE_SIZE);
-	// strncpy(memPage, buff, PAGE_SIZE);
+  if (transferPage(fi, memPage, pageNum, false) != RC_OK) return RC_FILE_R_W_ERROR;
 
-  // printf("this is a zero: %d\n", '\0');
-  // printf("Just read: %d %d %d\n", memPage[0], memPage[1], memPage[2]);
+  // atomic: a buffer pool reads and writes one handle from several threads
+  __atomic_store_n(&fHandle->curPagePos, pageNum, __ATOMIC_RELAXED);
 
-	fHandle->curPagePos = pageNum;
-
-	free(buff);
-	fclose(fp);
-
-	return RC_OK;
+  return RC_OK;
 }
 
 /* Return the current page position in a file. */
-int getBlockPos (SM_FileHandle *fHandle)
+PageNumber getBlockPos (SM_FileHandle *fHandle)
 {
 	return fHandle->curPagePos;
 }
@@ -241,7 +866,7 @@ readFirstBlock (SM_FileHandle *fHandle, SM_PageHandle memPage)
 	return readBlock(0,fHandle,memPage);
 }
 
-/* Read previous page relative to the curPagePos of the file, 
+/* Read previous page relative to the curPagePos of the file,
  * by calling readBlock() with pageNum = curPagePos - 1.
  * The value of curPagePos was set to curPagePos - 1 after reading.
  */
@@ -280,45 +905,122 @@ readLastBlock (SM_FileHandle *fHandle, SM_PageHandle memPage)
 	return readBlock(fHandle->totalNumPages-1,fHandle,memPage);;
 }
 
-/* Write what is in the memPage to the pageNumth block.
- * The value of curPagePos was set to pageNum after writing.
+/* Transfer numPages pages listed in pageNums to or from memPages[i]. Each run of
+ * consecutive page numbers in the list is moved with one transferRun; callers
+ * that want the fewest calls should pass the list sorted.
+ */
+static RC
+transferBlockList (PageNumber *pageNums, int numPages, SM_FileHandle *fHandle,
+                   SM_PageHandle *memPages, bool write)
+{
+  struct iovec *iov;
+  int i, run;
+  RC rc_code = RC_OK;
+  SM_FileInfo *fi;
+
+  if ((fi = handleInfo(fHandle)) == NULL) return RC_FILE_HANDLE_NOT_INIT;
+  if (numPages <= 0) return RC_OK;
+
+  for (i = 0; i < numPages; i++) {
+    if ((pageNums[i] >= fHandle->totalNumPages) || (pageNums[i] < 0)) return RC_READ_NON_EXISTING_PAGE;
+  }
+
+  iov = (struct iovec *)malloc(sizeof(struct iovec) * numPages);
+  for (i = 0; i < numPages; i++) {
+    iov[i].iov_base = memPages[i];
+    iov[i].iov_len = fHandle->pageSize;
+  }
+
+  for (i = 0; i < numPages && rc_code == RC_OK; i += run) {
+    run = 1;
+    while (i + run < numPages && pageNums[i + run] == pageNums[i] + run) run++;
+    rc_code = transferRun(fi, iov + i, run, pageNums[i], write);
+  }
+
+  free(iov);
+  if (rc_code == RC_OK) __atomic_store_n(&fHandle->curPagePos, pageNums[numPages - 1], __ATOMIC_RELAXED);
+  return rc_code;
+}
+
+/* Transfer numPages consecutive blocks starting at startPage to or from
+ * memPages[0..numPages-1]. curPagePos is left at the last page transferred.
+ */
+static RC
+transferBlockRange (PageNumber startPage, int numPages, SM_FileHandle *fHandle,
+                    SM_PageHandle *memPages, bool write)
+{
+  struct iovec *iov;
+  int i;
+  RC rc_code;
+  SM_FileInfo *fi;
+
+  if ((fi = handleInfo(fHandle)) == NULL) return RC_FILE_HANDLE_NOT_INIT;
+  if (numPages <= 0) return RC_OK;
+  if ((startPage < 0) || (startPage + numPages > fHandle->totalNumPages)) return RC_READ_NON_EXISTING_PAGE;
+
+  iov = (struct iovec *)malloc(sizeof(struct iovec) * numPages);
+  for (i = 0; i < numPages; i++) {
+    iov[i].iov_base = memPages[i];
+    iov[i].iov_len = fHandle->pageSize;
+  }
+  rc_code = transferRun(fi, iov, numPages, startPage, write);
+  free(iov);
+
+  if (rc_code == RC_OK) __atomic_store_n(&fHandle->curPagePos, startPage + numPages - 1, __ATOMIC_RELAXED);
+  return rc_code;
+}
+
+/* Read numPages consecutive blocks starting at startPage into memPages[0..numPages-1]
+ * with vectored positional reads.
  */
 RC
-writeBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
+readBlocks (PageNumber startPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages)
 {
-	FILE *fp;
-	int totalNumPages;
-	char *buff;
+  return transferBlockRange(startPage, numPages, fHandle, memPages, false);
+}
 
-	if (access(fHandle->fileName, R_OK) < 0) return RC_FILE_NOT_FOUND;
+/* Read the numPages blocks listed in pageNums, pageNums[i] into memPages[i]. */
+RC
+readBlockList (PageNumber *pageNums, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages)
+{
+  return transferBlockList(pageNums, numPages, fHandle, memPages, false);
+}
 
-	fp = fopen(fHandle->fileName, "r+");
+/* Write what is in the memPage to the pageNumth block, directly at its offset.
+ * The value of curPagePos was set to pageNum after writing.
+ */
+RC
+writeBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
+{
+  SM_FileInfo *fi;
 
-	buff = (char*)malloc(sizeof(char)*PAGE_SIZE);
+  if ((fi = handleInfo(fHandle)) == NULL) return RC_FILE_HANDLE_NOT_INIT;
 
-	if ((totalNumPages = readHeader(fp)) < 1) return RC_FILE_R_W_ERROR;
-	
-	//check if pageNum is valid 
-	if ((pageNum >= totalNumPages) || (pageNum < 0)) return RC_READ_NON_EXISTING_PAGE;
+  //check if pageNum is valid
+  if ((pageNum >= fHandle->totalNumPages) || (pageNum < 0)) return RC_READ_NON_EXISTING_PAGE;
 
-	//read till the (pageNum - 1)th page
-	int i;
-	for (i = 0; i < pageNum; i++) {
-		fread(buff, sizeof(char)*PAGE_SIZE, 1, fp);
-	}
-	
-	//write memPage to the pageNum
-	if (fwrite(memPage, sizeof(char)*PAGE_SIZE, 1, fp) < 1) return RC_WRITE_FAILED;
-  // printf("WRITED TO DISK (page-%i): %s\n", pageNum, memPage);
+  //write memPage to the pageNum
+  if (transferPage(fi, memPage, pageNum, true) != RC_OK) return RC_WRITE_FAILED;
 
-  // printf("#### Writed page (%d) to disk! ####\n", pageNum);
+  __atomic_store_n(&fHandle->curPagePos, pageNum, __ATOMIC_RELAXED);
 
-	fHandle->curPagePos = pageNum;
+  return RC_OK;
+}
 
-	free(buff);
-	fclose(fp);
+/* Write memPages[0..numPages-1] to numPages consecutive blocks starting at startPage
+ * with vectored positional writes.
+ */
+RC
+writeBlocks (PageNumber startPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages)
+{
+  return transferBlockRange(startPage, numPages, fHandle, memPages, true);
+}
 
-	return RC_OK;
+/* Write memPages[i] to block pageNums[i] for the numPages blocks listed. */
+RC
+writeBlockList (PageNumber *pageNums, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages)
+{
+  return transferBlockList(pageNums, numPages, fHandle, memPages, true);
 }
 
 /* Write the current block in the file by calling writeBlock() with pageNum = curPagePos. */
@@ -329,110 +1031,547 @@ writeCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage)
 }
 
 
-/* Increase the number of pages in the file by one. 
- * The new last page is filled with zero bytes.
+/* Increase the number of pages in the file by one.
+ * The new last page is zero bytes, taken from the preallocated extent or from
+ * a new one (see setExtentGrowth()).
+ * The header is only rewritten once every headerSyncInterval appends.
  */
 RC
 appendEmptyBlock (SM_FileHandle *fHandle)
 {
-	FILE *fp;
-	int totalNumPages, i, h_size;
-	char *buff;
-	// char zero = '\0';
+  RC rc_code;
 
-	if (access(fHandle->fileName, R_OK) < 0) return RC_FILE_NOT_FOUND;
+  if (handleInfo(fHandle) == NULL) return RC_FILE_HANDLE_NOT_INIT;
 
-	fp = fopen(fHandle->fileName, "r+");
+  if ((rc_code = allocateExtent(fHandle, fHandle->totalNumPages + 1)) != RC_OK) return rc_code;
 
-	buff = (char*)malloc(sizeof(char)*PAGE_SIZE);
+  fHandle->totalNumPages++;
 
-	if ((totalNumPages = readHeader(fp)) < 1) return RC_FILE_R_W_ERROR;
+  if (++((SM_FileInfo *)fHandle->mgmtInfo)->pendingAppends >= headerSyncInterval)
+    return flushHeader(fHandle);
 
-	rewind(fp);
+  return RC_OK;
+}
 
-	if (writeHeader(fp,totalNumPages+1) < 1) return RC_FILE_R_W_ERROR;
+/* If the file has less than numberOfPages pages, then increase the size to numberOfPages.
+ * The missing pages are allocated as one extent and count as that many appends
+ * towards the header sync interval, so the header is written at most once.
+ */
+RC
+ensureCapacity (PageNumber numberOfPages, SM_FileHandle *fHandle)
+{
+  RC rc_code;
+  SM_FileInfo *fi;
 
-	// printf("\n");
-	// printf("APPEND: ftell_pre-fseek %ld\n", ftell(fp));
-	
-	fseek(fp, 0L, SEEK_CUR);
-	
-	// printf("APPEND: ftell_post-fseek %ld\n", ftell(fp));
+  if (handleInfo(fHandle) == NULL) return RC_FILE_HANDLE_NOT_INIT;
 
-	//read to the end of the page file
-	for (i = 0; i < totalNumPages; i++) {
-		fread(buff, sizeof(char)*PAGE_SIZE, 1, fp);
-		// printf("APPEND: totalNumPages_header %d\n", totalNumPages);
-		// printf("APPEND: iteration %d\n", i);
-	}
-	fseek(fp, 0L, SEEK_CUR);
-	// fwrite(&zero, sizeof(char), PAGE_SIZE, fp);
+  if (numberOfPages <= fHandle->totalNumPages) return RC_OK;
 
-  // printf("Appending page (%d)...\n", totalNumPages);
-  memset(buff, 0, sizeof(*buff) * PAGE_SIZE);
-  fwrite(buff, sizeof(*buff) * PAGE_SIZE, 1, fp);
-  // printf("End of appending page...\n");
+  if ((rc_code = allocateExtent(fHandle, numberOfPages)) != RC_OK) return rc_code;
 
+  fi = (SM_FileInfo *)fHandle->mgmtInfo;
+  fi->pendingAppends += numberOfPages - fHandle->totalNumPages;
+  fHandle->totalNumPages = numberOfPages;
 
+  if (fi->pendingAppends >= headerSyncInterval)
+    return flushHeader(fHandle);
 
+  return RC_OK;
+}
 
-	fHandle->totalNumPages++;
-	fHandle->curPagePos;
+/************************************************************
+ *                    Asynchronous block I/O                *
+ ************************************************************/
 
-	free(buff);
-	fclose(fp);
+/* Worker threads used by the SM_AIO_THREADS backend (at most one per slot). */
+#define SM_AIO_WORKERS 4
 
-	// log file info to console
-  struct stat fileStat;
-  if(stat(fHandle->fileName,&fileStat) < 0)
-    return RC_FILE_R_W_ERROR;
-	// printf("\n\n**APPEND LOG**\n");
-	// printf("************************************\n");
-	// printf("File Name: \t\t%s\n",fHandle->fileName);
-	// printf("File Size: \t\t%lld bytes\n",fileStat.st_size);
-	// printf("Total # Pages: \t%d\n",fHandle->totalNumPages);
-  
-	return RC_OK;
+/* One asynchronous block transfer, from submission until it is reaped. */
+typedef struct SM_AsyncRequest {
+  PageNumber pageNum;
+  int fd;           // segment file holding the page
+  off_t offset;     // offset of the page in that file
+  char *buff;
+  void *tag;
+  bool write;
+  RC rc;
+  struct iovec iov; // io_uring reads/writes through this vector
+} SM_AsyncRequest;
+
+/* Submission/completion queue attached to an open file handle. Only one
+ * thread drives a queue; the lock protects the slot lists against the
+ * thread pool workers.
+ */
+typedef struct SM_AsyncQueue {
+  SM_AsyncBackend backend;
+  SM_FileInfo *fi;      // handle the queue belongs to
+  int pageSize;
+  bool direct;          // fd is O_DIRECT, buffers must be aligned
+  int depth;            // number of request slots
+  SM_AsyncRequest *reqs;
+  int *freeSlots;       // stack of unused slots
+  int numFree;
+  int *ready;           // ring of finished slots waiting to be reaped
+  int readyHead;
+  int readyCount;
+  pthread_mutex_t lock;
+  pthread_cond_t readyCond; // signalled when a slot finishes
+
+  // SM_AIO_THREADS
+  pthread_t *workers;
+  int numWorkers;
+  pthread_cond_t workCond;  // signalled when a slot is queued for the workers
+  int *pending;         // ring of submitted slots not yet picked up
+  int pendHead;
+  int pendCount;
+  bool stopping;
+
+#ifdef SM_HAVE_IO_URING
+  // SM_AIO_URING
+  int ringFd;
+  char *sqRing;
+  char *cqRing;
+  size_t sqRingSize;
+  size_t cqRingSize;
+  struct io_uring_sqe *sqes;
+  size_t sqesSize;
+  unsigned *sqTail, *sqMask, *sqArray;
+  unsigned *cqHead, *cqTail, *cqMask;
+  struct io_uring_cqe *cqes;
+#endif
+} SM_AsyncQueue;
+
+/* Queue a finished slot for reapBlocks. Called with q->lock held. */
+static void
+pushReady (SM_AsyncQueue *q, int slot)
+{
+  q->ready[(q->readyHead + q->readyCount) % q->depth] = slot;
+  q->readyCount++;
+  pthread_cond_signal(&q->readyCond);
+}
+
+/* Thread pool worker: take submitted slots and do the transfer synchronously. */
+static void *
+asyncWorker (void *arg)
+{
+  SM_AsyncQueue *q = (SM_AsyncQueue *)arg;
+  SM_AsyncRequest *r;
+  char *bounce = allocAligned(q->pageSize);
+  char *io;
+  bool direct;
+  int slot;
+
+  pthread_mutex_lock(&q->lock);
+  for (;;) {
+    while (q->pendCount == 0 && !q->stopping)
+      pthread_cond_wait(&q->workCond, &q->lock);
+    if (q->pendCount == 0) break;
+
+    slot = q->pending[q->pendHead];
+    q->pendHead = (q->pendHead + 1) % q->depth;
+    q->pendCount--;
+    pthread_mutex_unlock(&q->lock);
+
+    r = &q->reqs[slot];
+    // like transferPage, fall back to buffered I/O if O_DIRECT is refused
+    direct = (__atomic_load_n(&q->fi->mode, __ATOMIC_ACQUIRE) == SM_MODE_DIRECT);
+    io = (direct && !IS_IO_ALIGNED(r->buff)) ? bounce : r->buff;
+    if (r->write && io != r->buff) memcpy(io, r->buff, q->pageSize);
+    do {
+      r->rc = r->write ? pwriteFull(r->fd, io, q->pageSize, r->offset)
+                       : preadFull(r->fd, io, q->pageSize, r->offset);
+    } while (r->rc != RC_OK && dropDirectIO(q->fi, &direct));
+    if (r->rc == RC_OK && !r->write && io != r->buff) memcpy(r->buff, io, q->pageSize);
+
+    pthread_mutex_lock(&q->lock);
+    pushReady(q, slot);
+  }
+  pthread_mutex_unlock(&q->lock);
+
+  freePageBuffer(bounce);
+  return NULL;
+}
+
+#ifdef SM_HAVE_IO_URING
+/* Set up an io_uring with room for q->depth transfers.
+ * Return false if the kernel doesn't offer io_uring (or forbids it).
+ */
+static bool
+uringSetup (SM_AsyncQueue *q)
+{
+  struct io_uring_params p;
+
+  memset(&p, 0, sizeof(p));
+  if ((q->ringFd = syscall(__NR_io_uring_setup, q->depth, &p)) < 0) return false;
+
+  q->sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  q->cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    if (q->cqRingSize > q->sqRingSize) q->sqRingSize = q->cqRingSize;
+    q->cqRingSize = q->sqRingSize;
+  }
+
+  q->sqRing = mmap(NULL, q->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   q->ringFd, IORING_OFF_SQ_RING);
+  if (q->sqRing == MAP_FAILED) goto fail_ring;
+
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    q->cqRing = q->sqRing;
+  } else {
+    q->cqRing = mmap(NULL, q->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     q->ringFd, IORING_OFF_CQ_RING);
+    if (q->cqRing == MAP_FAILED) goto fail_sq;
+  }
+
+  q->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+  q->sqes = mmap(NULL, q->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                 q->ringFd, IORING_OFF_SQES);
+  if (q->sqes == MAP_FAILED) goto fail_cq;
+
+  q->sqTail = (unsigned *)(q->sqRing + p.sq_off.tail);
+  q->sqMask = (unsigned *)(q->sqRing + p.sq_off.ring_mask);
+  q->sqArray = (unsigned *)(q->sqRing + p.sq_off.array);
+  q->cqHead = (unsigned *)(q->cqRing + p.cq_off.head);
+  q->cqTail = (unsigned *)(q->cqRing + p.cq_off.tail);
+  q->cqMask = (unsigned *)(q->cqRing + p.cq_off.ring_mask);
+  q->cqes = (struct io_uring_cqe *)(q->cqRing + p.cq_off.cqes);
+  return true;
+
+fail_cq:
+  if (q->cqRing != q->sqRing) munmap(q->cqRing, q->cqRingSize);
+fail_sq:
+  munmap(q->sqRing, q->sqRingSize);
+fail_ring:
+  close(q->ringFd);
+  return false;
+}
+
+static void
+uringTeardown (SM_AsyncQueue *q)
+{
+  munmap(q->sqes, q->sqesSize);
+  if (q->cqRing != q->sqRing) munmap(q->cqRing, q->cqRingSize);
+  munmap(q->sqRing, q->sqRingSize);
+  close(q->ringFd);
+}
+
+/* Put the transfer in slot on the submission ring and hand it to the kernel. */
+static RC
+uringSubmit (SM_AsyncQueue *q, int slot)
+{
+  SM_AsyncRequest *r = &q->reqs[slot];
+  struct io_uring_sqe *sqe;
+  unsigned tail = *q->sqTail;
+  unsigned idx = tail & *q->sqMask;
+  int n;
+
+  r->iov.iov_base = r->buff;
+  r->iov.iov_len = q->pageSize;
+
+  sqe = &q->sqes[idx];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = r->write ? IORING_OP_WRITEV : IORING_OP_READV;
+  sqe->fd = r->fd;
+  sqe->addr = (unsigned long)&r->iov;
+  sqe->len = 1;
+  sqe->off = r->offset;
+  sqe->user_data = slot;
+
+  q->sqArray[idx] = idx;
+  __atomic_store_n(q->sqTail, tail + 1, __ATOMIC_RELEASE);
+
+  do {
+    n = syscall(__NR_io_uring_enter, q->ringFd, 1, 0, 0, NULL, 0);
+  } while (n < 0 && errno == EINTR);
+
+  return n == 1 ? RC_OK : RC_FILE_R_W_ERROR;
 }
 
-/* If the file has less than numberOfPages pages, then increase the size to numberOfPages. 
- * The increasing is done by appending (numberOfPages - totalNumPages) empty blocks 
- * at the end of file.
+/* Move everything on the completion ring to the ready list, waiting for at
+ * least one completion first if wait is set. Return RC_FILE_R_W_ERROR if
+ * waiting failed; what had finished is moved all the same.
+ */
+static RC
+uringCollect (SM_AsyncQueue *q, bool wait)
+{
+  struct io_uring_cqe *cqe;
+  SM_AsyncRequest *r;
+  unsigned head, tail;
+  RC rc_code = RC_OK;
+  int ret;
+
+  if (wait) {
+    while ((ret = syscall(__NR_io_uring_enter, q->ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0)) < 0
+           && errno == EINTR);
+    if (ret < 0) rc_code = RC_FILE_R_W_ERROR;
+  }
+
+  head = *q->cqHead;
+  tail = __atomic_load_n(q->cqTail, __ATOMIC_ACQUIRE);
+  pthread_mutex_lock(&q->lock);
+  for (; head != tail; head++) {
+    cqe = &q->cqes[head & *q->cqMask];
+    r = &q->reqs[cqe->user_data];
+    if (cqe->res == q->pageSize) r->rc = RC_OK;
+    else r->rc = r->write ? RC_WRITE_FAILED : RC_FILE_R_W_ERROR;
+    pushReady(q, (int)cqe->user_data);
+  }
+  pthread_mutex_unlock(&q->lock);
+  __atomic_store_n(q->cqHead, head, __ATOMIC_RELEASE);
+  return rc_code;
+}
+#endif
+
+/* Attach an asynchronous queue with room for queueDepth outstanding transfers
+ * to an open handle. SM_AIO_URING uses Linux io_uring, SM_AIO_THREADS a small
+ * pool of threads doing positional I/O, and SM_AIO_AUTO picks io_uring when the
+ * kernel allows it and threads otherwise. Return RC_ASYNC_NOT_AVAILABLE if
+ * io_uring was asked for and can't be used.
  */
 RC
-ensureCapacity (int numberOfPages, SM_FileHandle *fHandle)
-{
-    
-    FILE *fp;
-    int totalNumPages, i;
-    char *buff;
-    
-    if (access(fHandle->fileName, R_OK) < 0) return RC_FILE_NOT_FOUND;
-    
-    fp = fopen(fHandle->fileName, "r+");
-    
-    buff = (char*)malloc(sizeof(char)*PAGE_SIZE);
-    
-    if ((totalNumPages = readHeader(fp)) < 1) return RC_FILE_R_W_ERROR;
-    
-    if (numberOfPages > totalNumPages) {
-        for (i = 0; i < (numberOfPages - totalNumPages); i++) {
-            appendEmptyBlock(fHandle);
-        }
+initAsyncIO (SM_FileHandle *fHandle, int queueDepth, SM_AsyncBackend backend)
+{
+  SM_FileInfo *fi;
+  SM_AsyncQueue *q;
+  int i;
+
+  if ((fi = handleInfo(fHandle)) == NULL) return RC_FILE_HANDLE_NOT_INIT;
+  if (fi->aio != NULL) return RC_OK;
+  if (queueDepth < 1) queueDepth = 1;
+
+  q = (SM_AsyncQueue *)malloc(sizeof(SM_AsyncQueue));
+  memset(q, 0, sizeof(SM_AsyncQueue));
+  q->fi = fi;
+  q->pageSize = fi->pageSize;
+  q->direct = (__atomic_load_n(&fi->mode, __ATOMIC_ACQUIRE) == SM_MODE_DIRECT);
+  q->depth = queueDepth;
+  q->backend = SM_AIO_THREADS;
+
+#ifdef SM_HAVE_IO_URING
+  if (backend != SM_AIO_THREADS && uringSetup(q)) q->backend = SM_AIO_URING;
+#endif
+  if (backend == SM_AIO_URING && q->backend != SM_AIO_URING) {
+    free(q);
+    return RC_ASYNC_NOT_AVAILABLE;
+  }
+
+  q->reqs = (SM_AsyncRequest *)malloc(sizeof(SM_AsyncRequest) * queueDepth);
+  q->freeSlots = (int *)malloc(sizeof(int) * queueDepth);
+  q->ready = (int *)malloc(sizeof(int) * queueDepth);
+  q->pending = (int *)malloc(sizeof(int) * queueDepth);
+  for (i = 0; i < queueDepth; i++) {
+    q->freeSlots[i] = queueDepth - 1 - i;
+  }
+  q->numFree = queueDepth;
+  pthread_mutex_init(&q->lock, NULL);
+  pthread_cond_init(&q->readyCond, NULL);
+  pthread_cond_init(&q->workCond, NULL);
+
+  if (q->backend == SM_AIO_THREADS) {
+    q->numWorkers = queueDepth < SM_AIO_WORKERS ? queueDepth : SM_AIO_WORKERS;
+    q->workers = (pthread_t *)malloc(sizeof(pthread_t) * q->numWorkers);
+    for (i = 0; i < q->numWorkers; i++) {
+      pthread_create(&q->workers[i], NULL, asyncWorker, q);
     }
-    
-    // log file info to console
-    struct stat fileStat;
-    if(stat(fHandle->fileName,&fileStat) < 0)
-        return RC_FILE_R_W_ERROR;
-    // printf("\n\n**ENSURE LOG**\n");
-    // printf("************************************\n");
-    // printf("File Name: \t\t%s\n",fHandle->fileName);
-    // printf("File Size: \t\t%lld bytes\n",fileStat.st_size);
-    // printf("Total # Pages: \t%d\n",fHandle->totalNumPages);
-    
-    free(buff);
-    fclose(fp);
+  }
+
+  fi->aio = q;
+  return RC_OK;
+}
+
+/* Return the backend actually serving the handle's asynchronous queue. */
+SM_AsyncBackend
+getAsyncBackend (SM_FileHandle *fHandle)
+{
+  SM_FileInfo *fi = handleInfo(fHandle);
+
+  if (fi == NULL || fi->aio == NULL) return SM_AIO_AUTO;
+  return fi->aio->backend;
+}
 
+/* Start transferring one page between memPage and block pageNum. memPage must
+ * stay untouched until the transfer is returned by reapBlocks with the same tag.
+ */
+static RC
+submitBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *tag, bool write)
+{
+  SM_FileInfo *fi;
+  SM_AsyncQueue *q;
+  SM_AsyncRequest *r;
+  int slot;
+
+  if ((fi = handleInfo(fHandle)) == NULL || (q = fi->aio) == NULL) return RC_FILE_HANDLE_NOT_INIT;
+  if ((pageNum >= fHandle->totalNumPages) || (pageNum < 0)) return RC_READ_NON_EXISTING_PAGE;
+  if (write && fi->readOnly) return RC_WRITE_FAILED;
+
+  pthread_mutex_lock(&q->lock);
+  if (q->numFree == 0) {
+    pthread_mutex_unlock(&q->lock);
+    return RC_ASYNC_QUEUE_FULL;
+  }
+  slot = q->freeSlots[--q->numFree];
+  pthread_mutex_unlock(&q->lock);
+
+  r = &q->reqs[slot];
+  r->pageNum = pageNum;
+  r->fd = pageLocation(fi, pageNum, &r->offset, NULL);
+  r->buff = memPage;
+  r->tag = tag;
+  r->write = write;
+  r->rc = RC_OK;
+
+  // a mapped file is just a memcpy, and io_uring can't take unaligned buffers
+  // on an O_DIRECT file: finish those right away
+  if (fi->map != NULL || (q->backend == SM_AIO_URING && q->direct && !IS_IO_ALIGNED(memPage))) {
+    r->rc = transferPage(fi, memPage, pageNum, write);
+    pthread_mutex_lock(&q->lock);
+    pushReady(q, slot);
+    pthread_mutex_unlock(&q->lock);
+    return RC_OK;
+  }
+
+#ifdef SM_HAVE_IO_URING
+  if (q->backend == SM_AIO_URING) {
+    if ((r->rc = uringSubmit(q, slot)) != RC_OK) {
+      pthread_mutex_lock(&q->lock);
+      q->freeSlots[q->numFree++] = slot;
+      pthread_mutex_unlock(&q->lock);
+      return r->rc;
+    }
     return RC_OK;
+  }
+#endif
+
+  pthread_mutex_lock(&q->lock);
+  q->pending[(q->pendHead + q->pendCount) % q->depth] = slot;
+  q->pendCount++;
+  pthread_cond_signal(&q->workCond);
+  pthread_mutex_unlock(&q->lock);
+
+  return RC_OK;
+}
+
+/* Queue a read of block pageNum into memPage. */
+RC
+submitReadBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *tag)
+{
+  return submitBlock(pageNum, fHandle, memPage, tag, false);
+}
+
+/* Queue a write of memPage to block pageNum. */
+RC
+submitWriteBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *tag)
+{
+  return submitBlock(pageNum, fHandle, memPage, tag, true);
+}
+
+/* Return up to maxDone finished transfers in done[] and the number returned.
+ * With wait set, block until at least one transfer finishes unless none is
+ * outstanding. Return -1 if the handle has no asynchronous queue, or if
+ * waiting on io_uring failed with nothing finished; the transfers stay
+ * outstanding and may be reaped again.
+ */
+int
+reapBlocks (SM_FileHandle *fHandle, SM_IOCompletion *done, int maxDone, bool wait)
+{
+  SM_FileInfo *fi;
+  SM_AsyncQueue *q;
+  SM_AsyncRequest *r;
+  int n = 0, slot;
+
+  if ((fi = handleInfo(fHandle)) == NULL || (q = fi->aio) == NULL) return -1;
+
+#ifdef SM_HAVE_IO_URING
+  if (q->backend == SM_AIO_URING) {
+    bool failed;
+
+    pthread_mutex_lock(&q->lock);
+    wait = wait && q->readyCount == 0 && (q->depth - q->numFree) > 0;
+    pthread_mutex_unlock(&q->lock);
+    failed = (uringCollect(q, wait) != RC_OK);
+
+    pthread_mutex_lock(&q->lock);
+    failed = failed && q->readyCount == 0;
+    pthread_mutex_unlock(&q->lock);
+    if (failed) return -1;
+  }
+#endif
+
+  // only the thread pool workers signal readyCond; io_uring completions
+  // arrive through uringCollect above
+  pthread_mutex_lock(&q->lock);
+  while (wait && q->backend == SM_AIO_THREADS && q->readyCount == 0 && (q->depth - q->numFree) > 0)
+    pthread_cond_wait(&q->readyCond, &q->lock);
+
+  while (n < maxDone && q->readyCount > 0) {
+    slot = q->ready[q->readyHead];
+    q->readyHead = (q->readyHead + 1) % q->depth;
+    q->readyCount--;
+
+    r = &q->reqs[slot];
+    done[n].tag = r->tag;
+    done[n].pageNum = r->pageNum;
+    done[n].write = r->write;
+    done[n].rc = r->rc;
+    n++;
+
+    q->freeSlots[q->numFree++] = slot;
+  }
+  pthread_mutex_unlock(&q->lock);
+
+  return n;
+}
+
+/* Wait for every outstanding transfer, then detach and free the handle's
+ * asynchronous queue. Unreaped completions are dropped. Return
+ * RC_FILE_R_W_ERROR if the transfers could not be waited for; the queue
+ * is freed all the same and what was outstanding cancelled.
+ */
+RC
+shutdownAsyncIO (SM_FileHandle *fHandle)
+{
+  SM_FileInfo *fi;
+  SM_AsyncQueue *q;
+  SM_IOCompletion done[16];
+  RC rc_code = RC_OK;
+  int i;
+
+  if ((fi = handleInfo(fHandle)) == NULL || (q = fi->aio) == NULL) return RC_FILE_HANDLE_NOT_INIT;
+
+  // if the completions can't be waited for anymore, closing the ring below
+  // cancels what is left
+  while (q->numFree < q->depth) {
+    if (reapBlocks(fHandle, done, 16, true) < 0) {
+      rc_code = RC_FILE_R_W_ERROR;
+      break;
+    }
+  }
+
+  if (q->backend == SM_AIO_THREADS) {
+    pthread_mutex_lock(&q->lock);
+    q->stopping = true;
+    pthread_cond_broadcast(&q->workCond);
+    pthread_mutex_unlock(&q->lock);
+    for (i = 0; i < q->numWorkers; i++) {
+      pthread_join(q->workers[i], NULL);
+    }
+    free(q->workers);
+  }
+#ifdef SM_HAVE_IO_URING
+  else {
+    uringTeardown(q);
+  }
+#endif
+
+  pthread_mutex_destroy(&q->lock);
+  pthread_cond_destroy(&q->readyCond);
+  pthread_cond_destroy(&q->workCond);
+  free(q->reqs);
+  free(q->freeSlots);
+  free(q->ready);
+  free(q->pending);
+  free(q);
+  fi->aio = NULL;
+
+  return rc_code;
 }
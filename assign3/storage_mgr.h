@@ -2,42 +2,100 @@
 #define STORAGE_MGR_H
 
 #include "dberror.h"
+#include "dt.h"
 
 /************************************************************
  *                    handle data structures                *
  ************************************************************/
 typedef struct SM_FileHandle {
   char *fileName;
-  int totalNumPages;
-  int curPagePos;
+  PageNumber totalNumPages;
+  PageNumber curPagePos;
+  int pageSize;        // bytes per page, recorded in the file's superblock
   void *mgmtInfo;
 } SM_FileHandle;
 
 typedef char* SM_PageHandle;
 
+/* page sizes createPageFileWithSize accepts (powers of two in between) */
+#define SM_MIN_PAGE_SIZE 4096
+#define SM_MAX_PAGE_SIZE 65536
+
+/* how block reads/writes reach the page file */
+typedef enum SM_StorageMode {
+  SM_MODE_PREAD = 0,   // positional read/write system calls
+  SM_MODE_MMAP = 1,    // file mapped into memory, blocks copied with memcpy
+  SM_MODE_DIRECT = 2   // O_DIRECT, bypassing the OS page cache
+} SM_StorageMode;
+
+/* what serves a handle's asynchronous transfers */
+typedef enum SM_AsyncBackend {
+  SM_AIO_AUTO = 0,     // io_uring if the kernel allows it, threads otherwise
+  SM_AIO_URING = 1,    // Linux io_uring
+  SM_AIO_THREADS = 2   // pool of threads doing positional I/O
+} SM_AsyncBackend;
+
+/* a finished asynchronous transfer, as returned by reapBlocks */
+typedef struct SM_IOCompletion {
+  void *tag;           // tag given at submission
+  PageNumber pageNum;
+  bool write;
+  RC rc;
+} SM_IOCompletion;
+
+/* how the page file grows when appendEmptyBlock/ensureCapacity need space */
+typedef enum SM_GrowthPolicy {
+  SM_GROW_EXACT = 0,   // allocate exactly the pages requested
+  SM_GROW_FIXED = 1,   // allocate fixed-size extents
+  SM_GROW_DOUBLE = 2   // double the allocated size
+} SM_GrowthPolicy;
+
 /************************************************************
  *                    interface                             *
  ************************************************************/
 /* manipulating page files */
 extern void initStorageManager (void);
 extern RC createPageFile (char *fileName);
+extern RC createPageFileWithSize (char *fileName, int pageSize);
 extern RC openPageFile (char *fileName, SM_FileHandle *fHandle);
 extern RC closePageFile (SM_FileHandle *fHandle);
 extern RC destroyPageFile (char *fileName);
+extern RC syncPageFile (SM_FileHandle *fHandle);
+extern void setHeaderSyncInterval (int numberOfAppends);
+extern void setStorageMode (SM_StorageMode mode);
+extern void setSegmentSize (PageNumber pagesPerSegment);
+
+/* page buffers aligned for SM_MODE_DIRECT */
+extern SM_PageHandle allocPageBuffer (int numPages);
+extern SM_PageHandle allocFileBuffer (SM_FileHandle *fHandle, int numPages);
+extern void freePageBuffer (SM_PageHandle buff);
+extern void setExtentGrowth (SM_GrowthPolicy policy, int increment);
 
 /* reading blocks from disc */
-extern RC readBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
-extern int getBlockPos (SM_FileHandle *fHandle);
+extern RC readBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern PageNumber getBlockPos (SM_FileHandle *fHandle);
 extern RC readFirstBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readPreviousBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readNextBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readLastBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern RC readBlocks (PageNumber startPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages);
+extern RC readBlockList (PageNumber *pageNums, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages);
 
 /* writing blocks to a page file */
-extern RC writeBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern RC writeBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC writeCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern RC writeBlocks (PageNumber startPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages);
+extern RC writeBlockList (PageNumber *pageNums, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages);
 extern RC appendEmptyBlock (SM_FileHandle *fHandle);
-extern RC ensureCapacity (int numberOfPages, SM_FileHandle *fHandle);
+extern RC ensureCapacity (PageNumber numberOfPages, SM_FileHandle *fHandle);
+
+/* asynchronous block transfers */
+extern RC initAsyncIO (SM_FileHandle *fHandle, int queueDepth, SM_AsyncBackend backend);
+extern SM_AsyncBackend getAsyncBackend (SM_FileHandle *fHandle);
+extern RC submitReadBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *tag);
+extern RC submitWriteBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *tag);
+extern int reapBlocks (SM_FileHandle *fHandle, SM_IOCompletion *done, int maxDone, bool wait);
+extern RC shutdownAsyncIO (SM_FileHandle *fHandle);
 
 #endif
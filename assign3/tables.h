@@ -1,6 +1,7 @@
 #ifndef TABLES_H
 #define TABLES_H
 
+#include "dberror.h"
 #include "dt.h"
 
 #define ATTR_SIZE 32
@@ -25,7 +26,7 @@ typedef struct Value {
 } Value;
 
 typedef struct RID {
-  int page;
+  PageNumber page;
   int slot;
 } RID;
 
@@ -19,6 +19,12 @@ char *testName;
 /* prototypes for test functions */
 static void testCreateOpenClose(void);
 static void testSinglePageContent(void);
+static void testHeaderPersistence(void);
+static void testExtentGrowth(void);
+static void testMultiBlockIO(void);
+static void testAsyncIO(SM_AsyncBackend backend);
+static void testSegmentedFile(void);
+static void testPageSizes(void);
 
 /* main function running all tests */
 int
@@ -30,6 +36,28 @@ main (void)
 
   testCreateOpenClose();
   testSinglePageContent();
+  testHeaderPersistence();
+  testExtentGrowth();
+  testMultiBlockIO();
+  testAsyncIO(SM_AIO_AUTO);
+  testAsyncIO(SM_AIO_THREADS);
+  testSegmentedFile();
+  testPageSizes();
+
+  // same block tests against a memory mapped page file
+  setStorageMode(SM_MODE_MMAP);
+  testSinglePageContent();
+  testExtentGrowth();
+  testMultiBlockIO();
+
+  // and with O_DIRECT, bouncing the tests' unaligned buffers
+  setStorageMode(SM_MODE_DIRECT);
+  testSinglePageContent();
+  testExtentGrowth();
+  testMultiBlockIO();
+  testSegmentedFile();
+  testPageSizes();
+  setStorageMode(SM_MODE_PREAD);
 
   return 0;
 }
@@ -171,5 +199,309 @@ testSinglePageContent(void)
 
 
 
+  TEST_DONE();
+}
+
+/* Appends are counted in the handle and the header is only written on close */
+void
+testHeaderPersistence(void)
+{
+  SM_FileHandle fh;
+  int i;
+
+  testName = "test header persistence";
+
+  setHeaderSyncInterval(1000);
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  for (i = 0; i < 10; i++)
+    TEST_CHECK(appendEmptyBlock(&fh));
+  ASSERT_EQUALS_INT(11, fh.totalNumPages, "handle counts appended pages");
+  TEST_CHECK(closePageFile (&fh));
+
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(11, fh.totalNumPages, "page count persisted on close");
+  TEST_CHECK(appendEmptyBlock(&fh));
+  TEST_CHECK(syncPageFile(&fh));
+  TEST_CHECK(closePageFile (&fh));
+
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(12, fh.totalNumPages, "page count persisted on sync");
+  TEST_CHECK(closePageFile (&fh));
+
+  TEST_CHECK(destroyPageFile (TESTPF));
+  setHeaderSyncInterval(64);
+
+  TEST_DONE();
+}
+
+/* Growing by doubling extents preallocates space that is given back on close */
+void
+testExtentGrowth(void)
+{
+  SM_FileHandle fh, fh2;
+  SM_PageHandle ph;
+  struct stat fileStat;
+  int i;
+
+  testName = "test extent growth";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  setExtentGrowth(SM_GROW_DOUBLE, 4);
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(appendEmptyBlock(&fh));
+  stat(fh.fileName, &fileStat);
+  ASSERT_TRUE((fileStat.st_size == 6 * PAGE_SIZE), "append allocated a 4 page extent");
+  ASSERT_EQUALS_INT(2, fh.totalNumPages, "only one page was appended");
+
+  // reopening without a close must not turn the preallocated extent into pages
+  TEST_CHECK(syncPageFile(&fh));
+  TEST_CHECK(openPageFile (TESTPF, &fh2));
+  ASSERT_EQUALS_INT(2, fh2.totalNumPages, "reopen trusts the header over the file size");
+  TEST_CHECK(closePageFile (&fh2));
+  stat(TESTPF, &fileStat);
+  ASSERT_TRUE((fileStat.st_size == 3 * PAGE_SIZE), "close trimmed the leftover extent");
+
+  TEST_CHECK(ensureCapacity(1000, &fh));
+  ASSERT_EQUALS_INT(1000, fh.totalNumPages, "ensureCapacity grew the file in one extent");
+  TEST_CHECK(readBlock(999, &fh, ph));
+  for (i = 0; i < PAGE_SIZE; i++)
+    ASSERT_TRUE((ph[i] == 0), "expected zero byte in page of new extent");
+  TEST_CHECK(closePageFile (&fh));
+
+  stat(TESTPF, &fileStat);
+  ASSERT_TRUE((fileStat.st_size == 1001 * PAGE_SIZE), "close trimmed the file to its pages");
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(1000, fh.totalNumPages, "page count persisted on close");
+  TEST_CHECK(closePageFile (&fh));
+
+  TEST_CHECK(destroyPageFile (TESTPF));
+  setExtentGrowth(SM_GROW_EXACT, 1);
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* Write and read back ranges and lists of pages with the vectored calls */
+void
+testMultiBlockIO(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle pages[8];
+  PageNumber list[] = {7, 2, 3, 4, 0};
+  int i;
+
+  testName = "test multi block read and write";
+
+  for (i = 0; i < 8; i++)
+    pages[i] = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(ensureCapacity(8, &fh));
+
+  for (i = 0; i < 8; i++)
+    memset(pages[i], 'a' + i, PAGE_SIZE);
+  TEST_CHECK(writeBlocks(0, 8, &fh, pages));
+  ASSERT_EQUALS_INT(7, getBlockPos(&fh), "position is the last page written");
+
+  TEST_CHECK(readBlock(5, &fh, pages[0]));
+  ASSERT_TRUE((pages[0][0] == 'f' && pages[0][PAGE_SIZE - 1] == 'f'), "range write reached page 5");
+
+  TEST_CHECK(readBlockList(list, 5, &fh, pages));
+  for (i = 0; i < 5; i++)
+    ASSERT_TRUE((pages[i][0] == 'a' + list[i] && pages[i][PAGE_SIZE - 1] == 'a' + list[i]), "list read got the listed page");
+
+  memset(pages[0], 'z', PAGE_SIZE);
+  memset(pages[1], 'y', PAGE_SIZE);
+  TEST_CHECK(writeBlockList(list + 1, 2, &fh, pages));
+  TEST_CHECK(readBlocks(2, 2, &fh, pages + 2));
+  ASSERT_TRUE((pages[2][0] == 'z' && pages[3][PAGE_SIZE - 1] == 'y'), "list write reached pages 2 and 3");
+
+  ASSERT_ERROR(readBlocks(6, 3, &fh, pages), "range past the last page should fail");
+
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  for (i = 0; i < 8; i++)
+    free(pages[i]);
+
+  TEST_DONE();
+}
+
+/* Submit writes and reads of many pages and reap them in whatever order they finish */
+void
+testAsyncIO(SM_AsyncBackend backend)
+{
+  SM_FileHandle fh;
+  SM_PageHandle pages[16];
+  SM_IOCompletion done[16];
+  int i, j, n, reaped;
+
+  testName = "test asynchronous block I/O";
+
+  for (i = 0; i < 16; i++)
+    pages[i] = allocPageBuffer(1);
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(ensureCapacity(32, &fh));
+  TEST_CHECK(initAsyncIO(&fh, 16, backend));
+  ASSERT_TRUE((getAsyncBackend(&fh) != SM_AIO_AUTO), "a backend was chosen");
+
+  for (i = 0; i < 16; i++) {
+    memset(pages[i], 'A' + i, PAGE_SIZE);
+    TEST_CHECK(submitWriteBlock(2 * i, &fh, pages[i], pages[i]));
+  }
+  ASSERT_EQUALS_INT(RC_ASYNC_QUEUE_FULL, submitReadBlock(1, &fh, pages[0], NULL), "queue holds 16 transfers");
+
+  for (reaped = 0; reaped < 16; reaped += n) {
+    n = reapBlocks(&fh, done, 16, true);
+    for (j = 0; j < n; j++)
+      ASSERT_TRUE((done[j].rc == RC_OK && done[j].write), "write completed");
+  }
+
+  for (i = 0; i < 16; i++) {
+    memset(pages[i], 0, PAGE_SIZE);
+    TEST_CHECK(submitReadBlock(2 * i, &fh, pages[i], pages[i]));
+  }
+  for (reaped = 0; reaped < 16; reaped += n) {
+    n = reapBlocks(&fh, done, 4, true);
+    for (j = 0; j < n; j++) {
+      char *page = (char *)done[j].tag;
+      ASSERT_TRUE((done[j].rc == RC_OK && !done[j].write), "read completed");
+      ASSERT_TRUE((page[0] == 'A' + done[j].pageNum / 2 && page[PAGE_SIZE - 1] == page[0]), "read back the page written");
+    }
+  }
+  ASSERT_EQUALS_INT(0, reapBlocks(&fh, done, 16, true), "nothing left to reap");
+
+  TEST_CHECK(shutdownAsyncIO(&fh));
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  for (i = 0; i < 16; i++)
+    freePageBuffer(pages[i]);
+
+  TEST_DONE();
+}
+
+/* Spread a page file over segment files of 8 pages and move pages across
+ * segment boundaries */
+void
+testSegmentedFile(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle pages[20];
+  PageNumber list[] = {14, 6, 7, 8, 29};
+  int i;
+
+  testName = "test page file split into segment files";
+
+  for (i = 0; i < 20; i++)
+    pages[i] = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  setSegmentSize(8);
+  TEST_CHECK(createPageFile (TESTPF));
+  setSegmentSize(0);
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(ensureCapacity(30, &fh));
+  ASSERT_TRUE((access(TESTPF ".3", F_OK) == 0), "pages 23-29 live in the fourth segment");
+  ASSERT_TRUE((access(TESTPF ".4", F_OK) < 0), "no segment past the last page");
+
+  // pages 5..24 span three segment boundaries
+  for (i = 0; i < 20; i++)
+    memset(pages[i], 'a' + i, PAGE_SIZE);
+  TEST_CHECK(writeBlocks(5, 20, &fh, pages));
+  memset(pages[0], 'Z', PAGE_SIZE);
+  TEST_CHECK(writeBlock(29, &fh, pages[0]));
+  TEST_CHECK(closePageFile (&fh));
+
+  // the segment size comes from the header, not from setSegmentSize
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(30, fh.totalNumPages, "pages of all segments counted on open");
+
+  TEST_CHECK(readBlockList(list, 5, &fh, pages));
+  for (i = 0; i < 4; i++)
+    ASSERT_TRUE((pages[i][0] == 'a' + list[i] - 5 && pages[i][PAGE_SIZE - 1] == 'a' + list[i] - 5), "list read got the listed page");
+  ASSERT_TRUE((pages[4][0] == 'Z'), "last page read back from the last segment");
+
+  // a 64-bit page number must not wrap around to an existing page
+  ASSERT_ERROR(readBlock(((PageNumber) 1 << 32) + 1, &fh, pages[0]), "page 2^32+1 does not exist");
+
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+  ASSERT_TRUE((access(TESTPF ".1", F_OK) < 0), "segment files destroyed with the page file");
+
+  for (i = 0; i < 20; i++)
+    free(pages[i]);
+
+  TEST_DONE();
+}
+
+/* Page files with 32 KB pages next to the default 4 KB ones */
+void
+testPageSizes(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle pages[3];
+  struct stat st;
+  char foreign[2 * PAGE_SIZE];
+  int version = 99;
+  FILE *fp;
+  int i;
+
+  testName = "test page size recorded in the superblock";
+
+  ASSERT_EQUALS_INT(RC_INVALID_PAGE_SIZE, createPageFileWithSize(TESTPF, 6000), "page size must be a power of two");
+  ASSERT_EQUALS_INT(RC_INVALID_PAGE_SIZE, createPageFileWithSize(TESTPF, 2 * SM_MAX_PAGE_SIZE), "page size above the maximum");
+
+  TEST_CHECK(createPageFileWithSize(TESTPF, 32768));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(32768, fh.pageSize, "page size read from the superblock");
+  TEST_CHECK(ensureCapacity(3, &fh));
+
+  pages[0] = allocFileBuffer(&fh, 3);
+  for (i = 0; i < 3; i++) {
+    pages[i] = pages[0] + i * fh.pageSize;
+    memset(pages[i], 'a' + i, fh.pageSize);
+  }
+  TEST_CHECK(writeBlocks(0, 3, &fh, pages));
+  TEST_CHECK(closePageFile (&fh));
+
+  ASSERT_TRUE((stat(TESTPF, &st) == 0 && st.st_size == 4 * 32768), "header and 3 pages of 32 KB on disc");
+
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(3, fh.totalNumPages, "page count read with 32 KB pages");
+  memset(pages[0], 0, 3 * fh.pageSize);
+  TEST_CHECK(readBlock(2, &fh, pages[0]));
+  ASSERT_TRUE((pages[0][0] == 'c' && pages[0][fh.pageSize - 1] == 'c'), "whole 32 KB page read back");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+  freePageBuffer(pages[0]);
+
+  // the default stays at PAGE_SIZE
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(PAGE_SIZE, fh.pageSize, "default page size");
+  TEST_CHECK(closePageFile (&fh));
+
+  // a superblock from a newer format version is refused
+  fp = fopen(TESTPF, "r+b");
+  fseek(fp, 20, SEEK_SET);
+  fwrite(&version, sizeof(version), 1, fp);
+  fclose(fp);
+  ASSERT_EQUALS_INT(RC_UNSUPPORTED_FORMAT, openPageFile (TESTPF, &fh), "newer format version");
+
+  // so is a file that is no page file at all
+  memset(foreign, 'x', sizeof(foreign));
+  fp = fopen(TESTPF, "wb");
+  fwrite(foreign, sizeof(foreign), 1, fp);
+  fclose(fp);
+  ASSERT_EQUALS_INT(RC_UNSUPPORTED_FORMAT, openPageFile (TESTPF, &fh), "foreign file");
+  TEST_CHECK(destroyPageFile (TESTPF));
+
   TEST_DONE();
 }
@@ -4,9 +4,12 @@
 #include "dberror.h"
 #include "test_helper.h"
 
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 // var to store the current test's name
 char *testName;
@@ -37,6 +40,27 @@ static void testReadPage (void);
 
 static void testFIFO (void);
 static void testLRU (void);
+static void testLargePool (ReplacementStrategy strategy);
+static void testLRUPinnedVictim (void);
+static void testCLOCK (void);
+static void testLFU (void);
+static void testLRUK (void);
+static void testARC (void);
+static void testFrameArena (BM_HugePages mode);
+static void testConcurrentPins (ReplacementStrategy strategy);
+static void testShardedPool (void);
+static void testPageCleaner (void);
+static void testPrefetch (void);
+static void testScanRing (ReplacementStrategy strategy);
+static void testPoolStats (void);
+static void testResizePool (ReplacementStrategy strategy);
+static void testConcurrentResize (ReplacementStrategy strategy);
+static void testMultiFilePool (ReplacementStrategy strategy);
+static void testSortedFlush (int numShards);
+static void testUnpinNotPinned (void);
+static void testPrefetchFirstReference (ReplacementStrategy strategy);
+static void testPrintLargePage (void);
+static void testScanRingGhosts (void);
 
 // main method
 int 
@@ -49,6 +73,66 @@ main (void)
   testReadPage();
   testFIFO();
   testLRU();
+  testLargePool(RS_FIFO);
+  testLargePool(RS_LRU);
+  testLRUPinnedVictim();
+  testCLOCK();
+  testLargePool(RS_CLOCK);
+  testLFU();
+  testLargePool(RS_LFU);
+  testLRUK();
+  testLargePool(RS_LRU_K);
+  testARC();
+  testLargePool(RS_ARC);
+  testFrameArena(BM_HUGE_PAGES_OFF);
+  testFrameArena(BM_HUGE_PAGES_TRANSPARENT);
+  testFrameArena(BM_HUGE_PAGES_EXPLICIT);
+  testConcurrentPins(RS_FIFO);
+  testConcurrentPins(RS_LRU);
+  testConcurrentPins(RS_CLOCK);
+  testConcurrentPins(RS_LFU);
+  testConcurrentPins(RS_LRU_K);
+  testConcurrentPins(RS_ARC);
+  testShardedPool();
+  setPoolShards(4);
+  testConcurrentPins(RS_LRU);
+  testConcurrentPins(RS_CLOCK);
+  setPoolShards(1);
+  testPageCleaner();
+  setPageCleaner(1, 8, 50);
+  testConcurrentPins(RS_LRU);
+  testConcurrentPins(RS_CLOCK);
+  setPageCleaner(0, 0, 0);
+  testPrefetch();
+  testScanRing(RS_FIFO);
+  testScanRing(RS_LRU);
+  testScanRing(RS_CLOCK);
+  testScanRing(RS_LFU);
+  testScanRing(RS_LRU_K);
+  testScanRing(RS_ARC);
+  testPoolStats();
+  testResizePool(RS_FIFO);
+  testResizePool(RS_LRU);
+  testResizePool(RS_CLOCK);
+  testResizePool(RS_LFU);
+  testResizePool(RS_LRU_K);
+  testResizePool(RS_ARC);
+  testConcurrentResize(RS_LRU);
+  testConcurrentResize(RS_ARC);
+  testMultiFilePool(RS_LRU);
+  testMultiFilePool(RS_LRU_K);
+  testMultiFilePool(RS_ARC);
+  setPoolShards(4);
+  testMultiFilePool(RS_CLOCK);
+  setPoolShards(1);
+  testSortedFlush(1);
+  testSortedFlush(4);
+  testUnpinNotPinned();
+  testPrefetchFirstReference(RS_LFU);
+  testPrefetchFirstReference(RS_LRU_K);
+  testPrefetchFirstReference(RS_ARC);
+  testPrintLargePage();
+  testScanRingGhosts();
 }
 
 // create n pages with content "Page X" and read them back to check whether the content is right
@@ -81,7 +165,7 @@ createDummyPages(BM_BufferPool *bm, int num)
   for (i = 0; i < num; i++)
     {
       CHECK(pinPage(bm, h, i));
-      sprintf(h->data, "%s-%i", "Page", h->pageNum);
+      sprintf(h->data, "%s-%lld", "Page", h->pageNum);
       CHECK(markDirty(bm, h));
       CHECK(unpinPage(bm,h));
     }
@@ -104,7 +188,7 @@ checkDummyPages(BM_BufferPool *bm, int num)
     {
       CHECK(pinPage(bm, h, i));
 
-      sprintf(expected, "%s-%i", "Page", h->pageNum);
+      sprintf(expected, "%s-%lld", "Page", h->pageNum);
       ASSERT_EQUALS_STRING(expected, h->data, "reading back dummy page content");
 
       CHECK(unpinPage(bm,h));
@@ -294,3 +378,1156 @@ testLRU (void)
   free(h);
   TEST_DONE();
 }
+
+// pin many more pages than a large pool holds, then check that the most
+// recently loaded ones are found in the pool without any read
+void
+testLargePool (ReplacementStrategy strategy)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  char expected[64];
+  int numFrames = 500, numPages = 2000, reads, i;
+
+  testName = "Page lookup in a large pool";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", numFrames, strategy, NULL));
+
+  for (i = 0; i < numPages; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(h->data, "%s-%lld", "Page", h->pageNum);
+      CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_INT(numPages, getNumReadIO(bm), "every page was read once");
+
+  // the last numFrames pages are all still in the pool
+  reads = getNumReadIO(bm);
+  for (i = numPages - 1; i >= numPages - numFrames; i--)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(expected, "%s-%lld", "Page", (PageNumber) i);
+      if (strcmp(expected, h->data) != 0)
+        ASSERT_EQUALS_STRING(expected, h->data, "page found in its frame");
+      CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_INT(reads, getNumReadIO(bm), "all hits, no reads");
+
+  // evicted pages come back from disc with their content
+  for (i = 0; i < 100; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(expected, "%s-%lld", "Page", (PageNumber) i);
+      if (strcmp(expected, h->data) != 0)
+        ASSERT_EQUALS_STRING(expected, h->data, "evicted page read back");
+      CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_INT(reads + 100, getNumReadIO(bm), "evicted pages were read again");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// keep the least recently used page pinned; replacement has to pass it over
+// and evict the next least recently used frame instead
+void
+testLRUPinnedVictim (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PageHandle *pinned = MAKE_PAGE_HANDLE();
+  int i;
+
+  testName = "LRU skips a pinned victim";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+
+  CHECK(pinPage(bm, pinned, 0));
+  for (i = 1; i < 3; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(unpinPage(bm, h));
+    }
+
+  // page 0 is least recently used but still pinned, page 1 goes
+  CHECK(pinPage(bm, h, 3));
+  CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_POOL("[0 1],[3 0],[2 0]", bm, "page 1 was evicted");
+
+  // page 2 is next, then page 3
+  CHECK(pinPage(bm, h, 4));
+  CHECK(unpinPage(bm, h));
+  CHECK(pinPage(bm, h, 5));
+  CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_POOL("[0 1],[5 0],[4 0]", bm, "pinned page stays, others rotate");
+
+  CHECK(unpinPage(bm, pinned));
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  free(pinned);
+  TEST_DONE();
+}
+
+// test the CLOCK strategy: referenced pages get a second chance, pinned
+// pages are passed over by the hand
+void
+testCLOCK (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PageHandle *pinned = MAKE_PAGE_HANDLE();
+  int i;
+
+  testName = "Testing CLOCK page replacement";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_CLOCK, NULL));
+
+  for (i = 0; i < 3; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_POOL("[0 0],[1 0],[2 0]", bm, "pool filled");
+
+  // every frame is referenced, the hand clears all bits and comes back to 0
+  CHECK(pinPage(bm, h, 3));
+  CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_POOL("[3 0],[1 0],[2 0]", bm, "page 0 replaced after a full sweep");
+
+  // page 1 is used again, so page 2 goes instead
+  CHECK(pinPage(bm, h, 1));
+  CHECK(unpinPage(bm, h));
+  CHECK(pinPage(bm, h, 4));
+  CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_POOL("[3 0],[1 0],[4 0]", bm, "referenced page 1 kept");
+
+  // page 3 is pinned, the hand passes it over and takes page 1
+  CHECK(pinPage(bm, pinned, 3));
+  CHECK(pinPage(bm, h, 5));
+  CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_POOL("[3 1],[5 0],[4 0]", bm, "pinned page 3 kept");
+
+  CHECK(unpinPage(bm, pinned));
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  free(pinned);
+  TEST_DONE();
+}
+
+// test the LFU strategy: a page used often stays while pages used once
+// replace each other, least recently used first
+void
+testLFU (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  int i;
+
+  testName = "Testing LFU page replacement";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LFU, NULL));
+
+  for (i = 0; i < 3; i++)
+    {
+      CHECK(pinPage(bm, h, 0));
+      CHECK(unpinPage(bm, h));
+    }
+  for (i = 1; i < 3; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_POOL("[0 0],[1 0],[2 0]", bm, "pool filled");
+
+  CHECK(pinPage(bm, h, 3));
+  CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_POOL("[0 0],[3 0],[2 0]", bm, "page 1 used once and least recently");
+  CHECK(pinPage(bm, h, 4));
+  CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_POOL("[0 0],[3 0],[4 0]", bm, "frequently used page 0 kept");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// test LRU-2: pages referenced twice outlive one-off lookups, and the
+// history of an evicted page is remembered when it comes back
+void
+testLRUK (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  int k = 2;
+  int i;
+  // pin sequence and pool content after each pin
+  PageNumber requests[] = { 0, 0, 1, 2, 3, 4, 1, 5, 6 };
+  const char *poolContents[] = {
+    "[0 0],[-1 0],[-1 0]",
+    "[0 0],[-1 0],[-1 0]",
+    "[0 0],[1 0],[-1 0]",
+    "[0 0],[1 0],[2 0]",
+    "[0 0],[3 0],[2 0]",   // 1 and 2 have one reference, 1 is older
+    "[0 0],[3 0],[4 0]",
+    "[0 0],[1 0],[4 0]",   // page 1 comes back with its earlier reference
+    "[0 0],[1 0],[5 0]",
+    "[0 0],[1 0],[6 0]"    // page 1 now has two references and stays
+  };
+
+  testName = "Testing LRU-K page replacement";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU_K, &k));
+
+  for (i = 0; i < 9; i++)
+    {
+      CHECK(pinPage(bm, h, requests[i]));
+      CHECK(unpinPage(bm, h));
+      ASSERT_EQUALS_POOL(poolContents[i], bm, "check pool content");
+    }
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// test ARC: a scan does not push out pages used twice, and a miss on a
+// recently evicted scanned page makes the pool give recency more room
+void
+testARC (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolStats stats;
+  int reads, i, j;
+
+  testName = "Testing ARC page replacement";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 10, RS_ARC, NULL));
+  ASSERT_EQUALS_INT(0, getARCTarget(bm), "target size of T1 starts at 0");
+
+  // pages 0-4 are used twice
+  for (j = 0; j < 2; j++)
+    for (i = 0; i < 5; i++)
+      {
+        CHECK(pinPage(bm, h, i));
+        CHECK(unpinPage(bm, h));
+      }
+
+  // scan 100 pages once
+  for (i = 100; i < 200; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(unpinPage(bm, h));
+    }
+
+  reads = getNumReadIO(bm);
+  for (i = 0; i < 5; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_INT(reads, getNumReadIO(bm), "pages used twice survived the scan");
+
+  // page 194 was among the last ones evicted by the scan
+  CHECK(pinPage(bm, h, 194));
+  CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_INT(reads + 1, getNumReadIO(bm), "page 194 read again");
+  ASSERT_EQUALS_INT(1, getARCTarget(bm), "ghost hit in B1 grows the target size of T1");
+  CHECK(getPoolStats(bm, &stats));
+  ASSERT_EQUALS_INT(1, stats.arcTarget, "target size of T1 in the statistics");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// frames are consecutive pages of one arena, whichever memory backs it;
+// without reserved huge pages the explicit mode falls back on its own
+void
+testFrameArena (BM_HugePages mode)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  char expected[64];
+  char *first;
+  int numFrames = 600, i;
+
+  testName = "Frames in one arena";
+
+  setHugePages(mode);
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", numFrames, RS_FIFO, NULL));
+
+  CHECK(pinPage(bm, h, 0));
+  first = h->data;
+  ASSERT_TRUE(((uintptr_t) first % 4096) == 0, "arena aligned for O_DIRECT");
+  CHECK(unpinPage(bm, h));
+
+  for (i = 0; i < numFrames; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      if (h->data != first + (size_t) i * PAGE_SIZE)
+        ASSERT_TRUE(false, "frame i is page i of the arena");
+      sprintf(h->data, "%s-%i", "Page", i);
+      CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+
+  // write everything back through a second round of replacements
+  for (i = numFrames; i < 2 * numFrames; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(unpinPage(bm, h));
+    }
+  for (i = 0; i < numFrames; i += 50)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(expected, "%s-%i", "Page", i);
+      ASSERT_EQUALS_STRING(expected, h->data, "page written from the arena and read back");
+      CHECK(unpinPage(bm, h));
+    }
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+  setHugePages(BM_HUGE_PAGES_OFF);
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+#define STRESS_THREADS 8
+#define STRESS_PAGES 300
+#define STRESS_FRAMES 50
+#define STRESS_PINS 20000
+
+typedef struct StressArgs {
+  BM_BufferPool *bm;
+  unsigned int seed;
+  RC rc;
+} StressArgs;
+
+// pin random pages and increment the counter at the start of each under
+// its exclusive latch
+static void *
+stressWorker (void *arg)
+{
+  StressArgs *args = (StressArgs *) arg;
+  BM_PageHandle h;
+  int i;
+
+  args->rc = RC_OK;
+  for (i = 0; i < STRESS_PINS && args->rc == RC_OK; i++)
+    {
+      PageNumber pageNum = rand_r(&args->seed) % STRESS_PAGES;
+      if ((args->rc = pinPageLatched(args->bm, &h, pageNum, BM_LATCH_EXCLUSIVE)) != RC_OK)
+        break;
+      (*(int *) h.data)++;
+      markDirty(args->bm, &h);
+      args->rc = unpinPageLatched(args->bm, &h);
+    }
+  return NULL;
+}
+
+// many threads pinning, evicting and writing back pages of a small pool:
+// every increment has to survive, so no page is ever loaded twice or read
+// before its dirty copy is written back
+void
+testConcurrentPins (ReplacementStrategy strategy)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  pthread_t threads[STRESS_THREADS];
+  StressArgs args[STRESS_THREADS];
+  long total = 0;
+  int i;
+
+  testName = "Concurrent pins";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", STRESS_FRAMES, strategy, NULL));
+
+  for (i = 0; i < STRESS_THREADS; i++)
+    {
+      args[i].bm = bm;
+      args[i].seed = i + 1;
+      pthread_create(&threads[i], NULL, stressWorker, &args[i]);
+    }
+  for (i = 0; i < STRESS_THREADS; i++)
+    {
+      pthread_join(threads[i], NULL);
+      CHECK(args[i].rc);
+    }
+
+  for (i = 0; i < STRESS_PAGES; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      total += *(int *) h->data;
+      CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_INT(STRESS_THREADS * STRESS_PINS, total, "no increment lost");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// a pool split into shards behaves like one pool to its callers; the
+// statistics cover all shards
+void
+testShardedPool (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  char expected[64];
+  PageNumber *frameContents;
+  int numFrames = 100, numPages = 1000, resident = 0, i, j;
+
+  testName = "Sharded buffer pool";
+
+  setPoolShards(4);
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", numFrames, RS_LRU, NULL));
+  setPoolShards(1);
+
+  for (i = 0; i < numPages; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(h->data, "%s-%i", "Page", i);
+      CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_INT(numPages, getNumReadIO(bm), "reads of all shards counted");
+  ASSERT_EQUALS_INT(numPages - numFrames, getNumWriteIO(bm), "writes of all shards counted");
+
+  // every frame of every shard holds a different page
+  frameContents = getFrameContents(bm);
+  for (i = 0; i < numFrames; i++)
+    {
+      if (frameContents[i] != NO_PAGE)
+        resident++;
+      for (j = 0; j < i; j++)
+        if (frameContents[i] == frameContents[j])
+          ASSERT_TRUE(false, "page in one frame only");
+    }
+  ASSERT_EQUALS_INT(numFrames, resident, "all frames of all shards used");
+
+  for (i = 0; i < numPages; i += 7)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(expected, "%s-%i", "Page", i);
+      ASSERT_EQUALS_STRING(expected, h->data, "page content");
+      CHECK(unpinPage(bm, h));
+    }
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// the page cleaner writes dirty unpinned pages in the background, so
+// replacing them later needs no write on the eviction path
+void
+testPageCleaner (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  char expected[64];
+  int numFrames = 10, writes, i;
+
+  testName = "Background page cleaner";
+
+  setPageCleaner(1, 100, 100);
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", numFrames, RS_LRU, NULL));
+  setPageCleaner(0, 0, 0);
+
+  for (i = 0; i < numFrames; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(h->data, "%s-%i", "Page", i);
+      CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+
+  // the cleaner leaves one frame for pinners while it writes
+  for (i = 0; i < 5000 && getNumCleanerWrites(bm) < numFrames - 1; i++)
+    usleep(1000);
+  ASSERT_TRUE(getNumCleanerWrites(bm) >= numFrames - 1, "pages cleaned in the background");
+
+  for (i = numFrames; i < 2 * numFrames; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_INT(numFrames, getNumCleanerWrites(bm) + getNumEvictionWrites(bm), "every dirty page written once");
+  ASSERT_TRUE(getNumEvictionWrites(bm) <= 1, "victims were clean");
+
+  for (i = 0; i < numFrames; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(expected, "%s-%i", "Page", i);
+      ASSERT_EQUALS_STRING(expected, h->data, "cleaned page read back");
+      CHECK(unpinPage(bm, h));
+    }
+
+  // a shutdown refused for a pinned page leaves the cleaner running
+  CHECK(pinPage(bm, h, 0));
+  ASSERT_EQUALS_INT(RC_PINNED_PAGES, shutdownBufferPool(bm), "page 0 is pinned");
+  CHECK(unpinPage(bm, h));
+  writes = getNumCleanerWrites(bm);
+  CHECK(pinPage(bm, h, 1));
+  CHECK(markDirty(bm, h));
+  CHECK(unpinPage(bm, h));
+  for (i = 0; i < 5000 && getNumCleanerWrites(bm) == writes; i++)
+    usleep(1000);
+  ASSERT_EQUALS_INT(writes + 1, getNumCleanerWrites(bm), "page cleaned after the refused shutdown");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// prefetched pages are read in the background, so pinning them later
+// needs no read; a pin of a page still being prefetched waits for it
+void
+testPrefetch (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  PageNumber pages[12];
+  char expected[64];
+  int numFrames = 10, i;
+
+  testName = "Prefetching pages";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 20);
+  CHECK(initBufferPool(bm, "testbuffer.bin", numFrames, RS_LRU, NULL));
+
+  for (i = 0; i < 8; i++)
+    pages[i] = i;
+  pages[8] = 2;    // queued twice
+  pages[9] = 100;  // past the end of the file
+  CHECK(prefetchPages(bm, pages, 10));
+  for (i = 0; i < 5000 && getNumPrefetchReads(bm) < 8; i++)
+    usleep(1000);
+  ASSERT_EQUALS_INT(8, getNumPrefetchReads(bm), "pages prefetched once");
+  ASSERT_EQUALS_INT(8, getNumReadIO(bm), "prefetch reads counted");
+
+  for (i = 0; i < 8; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(expected, "%s-%i", "Page", i);
+      ASSERT_EQUALS_STRING(expected, h->data, "prefetched page content");
+      CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_INT(8, getNumReadIO(bm), "prefetched pages hit");
+
+  // pinned right after the request, each page is still read only once
+  for (i = 8; i < 20; i++)
+    pages[i - 8] = i;
+  CHECK(prefetchPages(bm, pages, 12));
+  for (i = 8; i < 20; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(expected, "%s-%i", "Page", i);
+      ASSERT_EQUALS_STRING(expected, h->data, "page content");
+      CHECK(unpinPage(bm, h));
+    }
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// a scan pinning through a ring recycles the ring's frames and leaves the
+// pages the rest of the pool holds alone, while still hitting them
+void
+testScanRing (ReplacementStrategy strategy)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_ScanRing *ring = createScanRing(4);
+  char expected[64];
+  int numFrames = 20, hot = 10, reads, i, j;
+
+  testName = "Scan ring";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", numFrames, strategy, NULL));
+
+  // the working set, used a few times
+  for (j = 0; j < 3; j++)
+    for (i = 0; i < hot; i++)
+      {
+        CHECK(pinPage(bm, h, i));
+        sprintf(h->data, "%s-%i", "Page", i);
+        CHECK(markDirty(bm, h));
+        CHECK(unpinPage(bm, h));
+      }
+
+  // a scan over far more pages than the pool holds, touching the working set too
+  for (i = 0; i < 200; i++)
+    {
+      CHECK(pinPageRing(bm, h, (i % 20 == 0) ? i / 20 : 100 + i, ring));
+      CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_INT(hot + 190, getNumReadIO(bm), "scan pages read once, working set hit");
+
+  reads = getNumReadIO(bm);
+  for (i = 0; i < hot; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(expected, "%s-%i", "Page", i);
+      ASSERT_EQUALS_STRING(expected, h->data, "working set page content");
+      CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_INT(reads, getNumReadIO(bm), "working set still in the pool");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  freeScanRing(ring);
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// the statistics snapshot counts pins, hits, misses and evictions of the
+// pool, and puts every miss in one latency bucket
+void
+testPoolStats (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolStats stats;
+  long long bucketed = 0;
+  int i;
+
+  testName = "Pool statistics";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+
+  // 5 misses, the last 2 evicting dirty pages, then 2 hits
+  for (i = 0; i < 5; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+  CHECK(pinPage(bm, h, 4));
+  CHECK(pinPage(bm, h, 3));
+  CHECK(unpinPage(bm, h));
+
+  CHECK(getPoolStats(bm, &stats));
+  ASSERT_EQUALS_INT(7, (int) stats.pins, "pins");
+  ASSERT_EQUALS_INT(6, (int) stats.unpins, "unpins");
+  ASSERT_EQUALS_INT(2, (int) stats.hits, "hits");
+  ASSERT_EQUALS_INT(5, (int) stats.misses, "misses");
+  ASSERT_EQUALS_INT(2, (int) stats.evictions, "evictions");
+  ASSERT_EQUALS_INT(2, (int) stats.dirtyWriteBacks, "dirty write backs");
+  ASSERT_EQUALS_INT(5, (int) stats.readIO, "reads");
+  ASSERT_EQUALS_INT(-1, stats.arcTarget, "no ARC target without RS_ARC");
+  for (i = 0; i < BM_LATENCY_BUCKETS; i++)
+    bucketed += stats.missLatency[i];
+  ASSERT_EQUALS_INT(5, (int) bucketed, "every miss timed");
+
+  h->pageNum = 4;
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// growing adds empty frames that are used before anything is evicted;
+// shrinking writes back the dirty pages it drops, refuses to drop pinned
+// ones, and pages pinned across both stay valid at the same address
+void
+testResizePool (ReplacementStrategy strategy)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PageHandle *pinned = MAKE_PAGE_HANDLE();
+  PageNumber *frameContents;
+  char *data;
+  int writes, resident, i;
+
+  testName = "Resizing a buffer pool";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, strategy, NULL));
+
+  // pages 0 to 3 end up dirty in the pool or written back, 4 stays pinned
+  for (i = 0; i < 4; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(h->data, "%s-%i", "Page", i);
+      CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+  CHECK(pinPage(bm, pinned, 4));
+  data = pinned->data;
+
+  CHECK(resizeBufferPool(bm, 6));
+  ASSERT_EQUALS_INT(6, bm->numPages, "pool grown");
+  writes = getNumWriteIO(bm);
+  for (i = 5; i < 8; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(h->data, "%s-%i", "Page", i);
+      CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_INT(writes, getNumWriteIO(bm), "new frames filled before evicting");
+
+  // 4 and 7 pinned: shrinking to 1 frame fails and changes nothing
+  CHECK(pinPage(bm, h, 7));
+  ASSERT_EQUALS_INT(RC_PINNED_PAGES, resizeBufferPool(bm, 1), "cannot drop pinned frames");
+  ASSERT_EQUALS_INT(6, bm->numPages, "pool unchanged");
+  ASSERT_EQUALS_INT(RC_INVALID_POOL_SIZE, resizeBufferPool(bm, 0), "pool needs a frame");
+
+  CHECK(resizeBufferPool(bm, 2));
+  ASSERT_EQUALS_INT(2, bm->numPages, "pool shrunk");
+  ASSERT_EQUALS_INT(writes + 4, getNumWriteIO(bm), "dropped dirty pages written back");
+  frameContents = getFrameContents(bm);
+  for (i = 0, resident = 0; i < bm->numPages; i++)
+    resident += (frameContents[i] == 4 || frameContents[i] == 7);
+  ASSERT_EQUALS_INT(2, resident, "pinned pages kept");
+
+  // the pin taken before the resizes still works
+  ASSERT_TRUE(pinned->data == data, "pinned page not moved");
+  sprintf(pinned->data, "%s-%i", "Page", 4);
+  CHECK(markDirty(bm, pinned));
+  CHECK(unpinPage(bm, pinned));
+  CHECK(unpinPage(bm, h));
+
+  CHECK(resizeBufferPool(bm, 4));
+  for (i = 0; i < 8; i++)
+    {
+      char expected[16];
+      sprintf(expected, "%s-%i", "Page", i);
+      CHECK(pinPage(bm, h, i));
+      ASSERT_EQUALS_STRING(expected, h->data, "page survived the resizes");
+      CHECK(unpinPage(bm, h));
+    }
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  free(pinned);
+  TEST_DONE();
+}
+
+typedef struct ResizeArgs {
+  BM_BufferPool *bm;
+  RC rc;
+} ResizeArgs;
+
+// resize the pool back and forth between STRESS_FRAMES / 2 and STRESS_FRAMES * 2
+static void *
+resizeWorker (void *arg)
+{
+  ResizeArgs *args = (ResizeArgs *) arg;
+  int i;
+
+  args->rc = RC_OK;
+  for (i = 0; i < 200 && args->rc == RC_OK; i++)
+    args->rc = resizeBufferPool(args->bm, (i % 2) ? STRESS_FRAMES / 2 : STRESS_FRAMES * 2);
+  return NULL;
+}
+
+// the stress test of testConcurrentPins with the pool resized meanwhile
+void
+testConcurrentResize (ReplacementStrategy strategy)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  pthread_t threads[STRESS_THREADS], resizer;
+  StressArgs args[STRESS_THREADS];
+  ResizeArgs resizeArgs;
+  long total = 0;
+  int i;
+
+  testName = "Resizing under concurrent pins";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", STRESS_FRAMES, strategy, NULL));
+
+  resizeArgs.bm = bm;
+  pthread_create(&resizer, NULL, resizeWorker, &resizeArgs);
+  for (i = 0; i < STRESS_THREADS; i++)
+    {
+      args[i].bm = bm;
+      args[i].seed = i + 1;
+      pthread_create(&threads[i], NULL, stressWorker, &args[i]);
+    }
+  pthread_join(resizer, NULL);
+  CHECK(resizeArgs.rc);
+  for (i = 0; i < STRESS_THREADS; i++)
+    {
+      pthread_join(threads[i], NULL);
+      CHECK(args[i].rc);
+    }
+
+  for (i = 0; i < STRESS_PAGES; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      total += *(int *) h->data;
+      CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_INT(STRESS_THREADS * STRESS_PINS, total, "no increment lost");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// one pool caching the pages of two files: pages of the same number in
+// different files are different pages, evicted and written back to their
+// own file; a file leaves the pool only once none of its pages is pinned
+void
+testMultiFilePool (ReplacementStrategy strategy)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  char expected[32];
+  int other, again, f, i;
+
+  testName = "Buffer pool shared by page files";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(createPageFile("testbuffer2.bin"));
+  CHECK(createPageFileWithSize("testbuffer3.bin", 2 * PAGE_SIZE));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 4, strategy, NULL));
+
+  CHECK(registerPageFile(bm, "testbuffer2.bin", &other));
+  ASSERT_TRUE(other != 0, "own id for the second file");
+  CHECK(registerPageFile(bm, "testbuffer2.bin", &again));
+  ASSERT_EQUALS_INT(other, again, "registered once");
+  ASSERT_EQUALS_INT(RC_INVALID_PAGE_SIZE, registerPageFile(bm, "testbuffer3.bin", &again), "page sizes must match");
+
+  // 20 pages for 4 frames: most of them are evicted and written back
+  for (i = 0; i < 10; i++)
+    for (f = 0; f < 2; f++)
+      {
+        CHECK(pinPage(bm, h, BM_FILE_PAGE(f ? other : 0, i)));
+        sprintf(h->data, "File-%i-Page-%i", f, i);
+        CHECK(markDirty(bm, h));
+        CHECK(unpinPage(bm, h));
+      }
+  for (i = 0; i < 10; i++)
+    for (f = 0; f < 2; f++)
+      {
+        sprintf(expected, "File-%i-Page-%i", f, i);
+        CHECK(pinPage(bm, h, BM_FILE_PAGE(f ? other : 0, i)));
+        ASSERT_EQUALS_STRING(expected, h->data, "page read back from its file");
+        CHECK(unpinPage(bm, h));
+      }
+
+  CHECK(pinPage(bm, h, BM_FILE_PAGE(other, 9)));
+  ASSERT_EQUALS_INT(RC_PINNED_PAGES, unregisterPageFile(bm, other), "pinned file stays");
+  CHECK(unpinPage(bm, h));
+  CHECK(unregisterPageFile(bm, other));
+  ASSERT_TRUE(pinPage(bm, h, BM_FILE_PAGE(other, 0)) != RC_OK, "no pages of an unregistered file");
+  ASSERT_EQUALS_INT(RC_FILE_HANDLE_NOT_INIT, unregisterPageFile(bm, 0), "own file stays");
+
+  // the second file kept its pages, written back on unregistering
+  CHECK(registerPageFile(bm, "testbuffer2.bin", &other));
+  for (i = 0; i < 10; i++)
+    {
+      sprintf(expected, "File-%i-Page-%i", 1, i);
+      CHECK(pinPage(bm, h, BM_FILE_PAGE(other, i)));
+      ASSERT_EQUALS_STRING(expected, h->data, "page written back on unregistering");
+      CHECK(unpinPage(bm, h));
+    }
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+  CHECK(destroyPageFile("testbuffer2.bin"));
+  CHECK(destroyPageFile("testbuffer3.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// a flush writes the dirty unpinned pages of every shard and file, sorted
+// into runs of adjacent pages, and leaves pinned pages alone
+void
+testSortedFlush (int numShards)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PageHandle *pinned = MAKE_PAGE_HANDLE();
+  SM_FileHandle fh;
+  SM_PageHandle buf;
+  char expected[32];
+  bool *dirty;
+  int other, dirtyCount = 0, f, i;
+
+  testName = "Sorted flush";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(createPageFile("testbuffer2.bin"));
+  // the files are reopened behind the pool's back, so keep their headers current
+  setHeaderSyncInterval(1);
+  setPoolShards(numShards);
+  CHECK(initBufferPool(bm, "testbuffer.bin", 100, RS_LRU, NULL));
+  setPoolShards(1);
+  CHECK(registerPageFile(bm, "testbuffer2.bin", &other));
+
+  // dirty 40 pages of each file, backwards, with a gap at page 20
+  for (i = 40; i >= 0; i--)
+    for (f = 0; f < 2; f++)
+      {
+        if (i == 20)
+          continue;
+        CHECK(pinPage(bm, h, BM_FILE_PAGE(f ? other : 0, i)));
+        sprintf(h->data, "File-%i-Page-%i", f, i);
+        CHECK(markDirty(bm, h));
+        CHECK(unpinPage(bm, h));
+      }
+  CHECK(pinPage(bm, pinned, 30));
+  CHECK(markDirty(bm, pinned));
+
+  CHECK(forceFlushPool(bm));
+  ASSERT_EQUALS_INT(79, getNumWriteIO(bm), "every unpinned dirty page written once");
+  dirty = getDirtyFlags(bm);
+  for (i = 0; i < bm->numPages; i++)
+    dirtyCount += dirty[i];
+  ASSERT_EQUALS_INT(1, dirtyCount, "only the pinned page left dirty");
+
+  // the pages are in their own files, at their own place
+  for (f = 0; f < 2; f++)
+    {
+      CHECK(openPageFile(f ? "testbuffer2.bin" : "testbuffer.bin", &fh));
+      buf = allocFileBuffer(&fh, 1);
+      for (i = 0; i <= 40; i++)
+        {
+          if (i == 20 || (f == 0 && i == 30))
+            continue;
+          sprintf(expected, "File-%i-Page-%i", f, i);
+          CHECK(readBlock(i, &fh, buf));
+          ASSERT_EQUALS_STRING(expected, buf, "flushed page on disk");
+        }
+      freePageBuffer(buf);
+      CHECK(closePageFile(&fh));
+    }
+
+  CHECK(unpinPage(bm, pinned));
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+  CHECK(destroyPageFile("testbuffer2.bin"));
+  setHeaderSyncInterval(64);
+
+  free(bm);
+  free(h);
+  free(pinned);
+  TEST_DONE();
+}
+
+// unpinning a page that is not pinned must be refused without touching the fix counts
+void
+testUnpinNotPinned (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PageHandle *other = MAKE_PAGE_HANDLE();
+
+  testName = "Unpin not pinned";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+
+  CHECK(pinPage(bm, h, 0));
+  CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_INT(RC_PAGE_NOT_PINNED, unpinPage(bm, h), "second unpin refused");
+  ASSERT_EQUALS_INT(0, getFixCounts(bm)[0], "fix count stays at zero");
+  ASSERT_EQUALS_INT(RC_PAGE_NOT_PINNED, markDirty(bm, h), "resident page no longer pinned");
+  ASSERT_EQUALS_INT(RC_OK, forcePage(bm, h), "resident page written without a pin");
+  ASSERT_EQUALS_INT(0, getFixCounts(bm)[0], "no pin left behind by the write");
+
+  other->pageNum = 5;
+  other->data = h->data;
+  ASSERT_EQUALS_INT(RC_PAGE_NOT_PINNED, unpinPage(bm, other), "page not in the pool");
+  ASSERT_EQUALS_INT(RC_PAGE_NOT_PINNED, markDirty(bm, other), "no frame to mark dirty");
+  ASSERT_EQUALS_INT(RC_PAGE_NOT_PINNED, forcePage(bm, other), "no frame to write");
+  ASSERT_EQUALS_INT(RC_PAGE_NOT_PINNED, unpinPageLatched(bm, other), "no frame latch to release");
+
+  // pins are still counted right after the refused unpins
+  CHECK(pinPage(bm, h, 0));
+  ASSERT_EQUALS_INT(RC_PINNED_PAGES, shutdownBufferPool(bm), "pinned page blocks shutdown");
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(h);
+  free(other);
+  free(bm);
+  TEST_DONE();
+}
+
+// a prefetched page pinned once has been referenced once: it is the first
+// victim among pages referenced once (for ARC, it is still in T1)
+void
+testPrefetchFirstReference (ReplacementStrategy strategy)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  PageNumber first = 0;
+  int reads, i;
+
+  testName = "Prefetched page referenced once";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 10);
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, strategy, NULL));
+
+  CHECK(prefetchPages(bm, &first, 1));
+  for (i = 0; i < 5000 && getNumPrefetchReads(bm) < 1; i++)
+    usleep(1000);
+  ASSERT_EQUALS_INT(1, getNumPrefetchReads(bm), "page 0 prefetched");
+
+  for (i = 0; i < 4; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(unpinPage(bm, h));
+    }
+
+  // page 3 took the frame of page 0, the oldest page referenced once
+  reads = getNumReadIO(bm);
+  for (i = 1; i < 4; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_INT(reads, getNumReadIO(bm), "pages 1 to 3 still resident");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// page dumps cover the whole page of the pool's file, not PAGE_SIZE bytes
+void
+testPrintLargePage (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  int pageSize = 8 * PAGE_SIZE;
+  char *dump;
+  size_t len;
+
+  testName = "Printing a large page";
+
+  CHECK(createPageFileWithSize("testbuffer.bin", pageSize));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+
+  CHECK(pinPage(bm, h, 0));
+  h->data[0] = (char) 0x12;
+  h->data[pageSize - 1] = (char) 0xAB;
+  dump = sprintPageContent(bm, h);
+  len = strlen(dump);
+  ASSERT_EQUALS_INT(9 + 2 * pageSize + pageSize / 8 + pageSize / 64, (int) len, "every byte of the page dumped");
+  ASSERT_TRUE(strncmp(dump + 9, "12", 2) == 0, "dump starts with the first byte");
+  ASSERT_TRUE(strcmp(dump + len - 4, "AB \n") == 0, "dump ends with the last byte");
+  free(dump);
+  CHECK(unpinPage(bm, h));
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// pages a scan ring evicts are remembered by ARC like any other evicted page
+void
+testScanRingGhosts (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_ScanRing *ring = createScanRing(2);
+  BM_PoolStats stats;
+  int i;
+
+  testName = "Scan ring evictions under ARC";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 4, RS_ARC, NULL));
+
+  // the third scan page reuses the frame of page 0
+  for (i = 0; i < 3; i++)
+    {
+      CHECK(pinPageRing(bm, h, i, ring));
+      CHECK(unpinPage(bm, h));
+    }
+  CHECK(getPoolStats(bm, &stats));
+  ASSERT_EQUALS_INT(0, stats.arcTarget, "no ghost hit yet");
+
+  // page 0 is found in B1, which grows the target size of T1
+  CHECK(pinPage(bm, h, 0));
+  CHECK(unpinPage(bm, h));
+  CHECK(getPoolStats(bm, &stats));
+  ASSERT_EQUALS_INT(1, stats.arcTarget, "page evicted by the ring remembered in B1");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  freeScanRing(ring);
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
@@ -55,6 +55,9 @@ static void testScans (void);
 static void testScansTwo (void);
 static void testInsertManyRecords(void);
 static void testMultipleScans(void);
+static void testPageReuse(void);
+static void testLargePages(void);
+static void testClockPool(void);
 
 // struct for test records
 typedef struct TestRecord {
@@ -84,6 +87,9 @@ main (void)
   testScans();
   testScansTwo();
   testMultipleScans();
+  testPageReuse();
+  testLargePages();
+  testClockPool();
 
   return 0;
 }
@@ -259,6 +265,158 @@ testMultipleScans(void)
   TEST_DONE();
 }
 
+void
+testPageReuse (void)
+{
+  RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+  TestRecord in = {1, "aaaa", 3};
+  RM_SpaceInfo before, deleted, after;
+  int numInserts = 1000, round, i;
+  Record *r;
+  Schema *schema;
+  testName = "test deleted table pages are reused by the next table";
+  schema = testSchema();
+
+  TEST_CHECK(initRecordManager(NULL));
+  TEST_CHECK(createTable("test_table_keep",schema));
+
+  for (round = 0; round < 2; round++)
+    {
+      TEST_CHECK(createTable("test_table_r",schema));
+      TEST_CHECK(openTable(table, "test_table_r"));
+      for(i = 0; i < numInserts; i++)
+        {
+          r = fromTestRecord(schema, in);
+          TEST_CHECK(insertRecord(table,r));
+          freeRecord(r);
+        }
+      TEST_CHECK(closeTable(table));
+
+      TEST_CHECK(reportFragmentation(round == 0 ? &before : &after));
+      TEST_CHECK(deleteTable("test_table_r"));
+      TEST_CHECK(reportFragmentation(&deleted));
+      ASSERT_TRUE(deleted.freePages > 1, "deleted table pages are on the free list");
+      ASSERT_EQUALS_INT(deleted.totalPages, deleted.usedPages + deleted.freePages, "page accounting");
+    }
+
+  // the second round must have been served entirely from the free list
+  ASSERT_EQUALS_INT(before.totalPages, after.totalPages, "file did not grow");
+
+  TEST_CHECK(deleteTable("test_table_keep"));
+  TEST_CHECK(shutdownRecordManager());
+
+  free(table);
+  TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testLargePages (void)
+{
+  RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+  RM_Config config = { "test_large_pages.bin", 32768 };
+  TestRecord inserts[] = {
+    {1, "aaaa", 3},
+    {2, "bbbb", 2},
+    {3, "cccc", 1}
+  };
+  int numInserts = 3000, i;
+  Record *r;
+  RID *rids;
+  Schema *schema;
+  testName = "test a database file with 32 KB pages";
+  schema = testSchema();
+  rids = (RID *) malloc(sizeof(RID) * numInserts);
+
+  remove(config.pageFile);
+  TEST_CHECK(initRecordManager(&config));
+  TEST_CHECK(createTable("test_table_r",schema));
+  TEST_CHECK(openTable(table, "test_table_r"));
+
+  for(i = 0; i < numInserts; i++)
+    {
+      r = fromTestRecord(schema, inserts[i % 3]);
+      TEST_CHECK(insertRecord(table,r));
+      rids[i] = r->id;
+      freeRecord(r);
+    }
+  // 32 KB pages hold 8 times the records of the 4 KB default
+  ASSERT_TRUE((rids[numInserts - 1].page < numInserts * getRecordSize(schema) / 32768 + 1), "records packed into 32 KB pages");
+
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(openTable(table, "test_table_r"));
+
+  r = fromTestRecord(schema, inserts[0]);
+  for(i = 0; i < numInserts; i += 7)
+    {
+      TEST_CHECK(getRecord(table, rids[i], r));
+      ASSERT_EQUALS_RECORDS(fromTestRecord(schema, inserts[i % 3]), r, schema, "compare records");
+    }
+  freeRecord(r);
+
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(deleteTable("test_table_r"));
+  TEST_CHECK(shutdownRecordManager());
+  remove(config.pageFile);
+
+  free(rids);
+  free(table);
+  TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testClockPool (void)
+{
+  RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+  RM_Config config = { "test_clock_pool.bin", 0, 8, RS_CLOCK };
+  TestRecord inserts[] = {
+    {1, "aaaa", 3},
+    {2, "bbbb", 2},
+    {3, "cccc", 1}
+  };
+  int numInserts = 5000, i;
+  Record *r;
+  RID *rids;
+  Schema *schema;
+  testName = "test a small CLOCK buffer pool under the record manager";
+  schema = testSchema();
+  rids = (RID *) malloc(sizeof(RID) * numInserts);
+
+  remove(config.pageFile);
+  TEST_CHECK(initRecordManager(&config));
+  TEST_CHECK(createTable("test_table_r",schema));
+  TEST_CHECK(openTable(table, "test_table_r"));
+
+  for(i = 0; i < numInserts; i++)
+    {
+      r = fromTestRecord(schema, inserts[i % 3]);
+      TEST_CHECK(insertRecord(table,r));
+      rids[i] = r->id;
+      freeRecord(r);
+    }
+  // the table spans more pages than the pool has frames
+  ASSERT_TRUE((rids[numInserts - 1].page > 8), "table larger than the pool");
+
+  r = fromTestRecord(schema, inserts[0]);
+  for(i = 0; i < numInserts; i += 5)
+    {
+      TEST_CHECK(getRecord(table, rids[i], r));
+      ASSERT_EQUALS_RECORDS(fromTestRecord(schema, inserts[i % 3]), r, schema, "compare records");
+    }
+  freeRecord(r);
+
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(deleteTable("test_table_r"));
+  TEST_CHECK(shutdownRecordManager());
+  remove(config.pageFile);
+
+  free(rids);
+  free(table);
+  TEST_DONE();
+}
+
+// ************************************************************ 
 void 
 testUpdateTable (void)
 {
@@ -399,7 +557,7 @@ testInsertManyRecords(void)
     {
       RID rid = rids[i];
       
-      printf("Testing #(%d) getRecord [%d-%d]\n", i, rid.page, rid.slot);
+      printf("Testing #(%d) getRecord [%lld-%d]\n", i, rid.page, rid.slot);
       
       TEST_CHECK(getRecord(table, rid, r));
       ASSERT_EQUALS_RECORDS(fromTestRecord(schema, realInserts[i]), r, schema, "compare records");
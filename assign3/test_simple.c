@@ -59,7 +59,7 @@ Record *testCreateRecord(Schema *schema) {
   Record *record;
   createRecord(&record, schema);
 
-  printf("record->id->page:\t\t%i\n", (record->id).page);
+  printf("record->id->page:\t\t%lld\n", (record->id).page);
   printf("record->id->slot:\t\t%i\n", (record->id).slot);
   printf("record->data:\t\t%s\n", record->data);
 
@@ -220,7 +220,7 @@ void testGetRecord(RM_TableData *rel, RID id) {
   createRecord(&record, rel->schema);
   RC r = getRecord(rel, id, record);
   printf("\nReturn code from getRecord is %d\n", r);
-  printf("\nRID of the returned record is page: %d, slot: %d\n", record->id.page, record->id.slot);
+  printf("\nRID of the returned record is page: %lld, slot: %d\n", record->id.page, record->id.slot);
 
   char *recordData = serializeRecord(record, rel->schema);
   printf("\nThe record now have the following data: \n%s\n", recordData);